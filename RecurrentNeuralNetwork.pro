@@ -2,20 +2,51 @@ QT += core
 QT -= gui
 
 TARGET = RecurrentNeuralNetwork
-CONFIG += console
+CONFIG += console c++11 thread
 CONFIG -= app_bundle
 
 TEMPLATE = app
 
+# Single precision weights and activations (see rnnkernels.h):
+# DEFINES += rnnfloat_t=float
+
 SOURCES += main.cpp \
     rnn.cpp \
     io.cpp \
     text.cpp \
-    rnnstate.cpp
+    rnnstate.cpp \
+    alignedmemory.cpp \
+    rnnweights.cpp \
+    rnnkernels.cpp \
+    rnnactivation.cpp \
+    quantizedrnn.cpp \
+    rnnthreadteam.cpp \
+    rnntrainer.cpp \
+    rnncheckpoint.cpp \
+    mappedfile.cpp \
+    rnnmodelfile.cpp \
+    rnncorpusreader.cpp \
+    rnngenerator.cpp \
+    rnnbeamsearch.cpp \
+    rnnsession.cpp
 
 HEADERS += \
     rnn.h \
     io.h \
     text.h \
-    rnnstate.h
+    rnnstate.h \
+    alignedmemory.h \
+    rnnweights.h \
+    rnnkernels.h \
+    rnnactivation.h \
+    quantizedrnn.h \
+    rnnthreadteam.h \
+    rnntrainer.h \
+    rnncheckpoint.h \
+    mappedfile.h \
+    rnnmodelfile.h \
+    rnncorpusreader.h \
+    rnngenerator.h \
+    rnnbeamsearch.h \
+    rnnsession.h
 
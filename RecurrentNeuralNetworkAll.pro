@@ -0,0 +1,11 @@
+# Builds the network demo, the local inference server and its load generator side by side.
+TEMPLATE = subdirs
+
+SUBDIRS = demo server loadgenerator
+
+demo.file = RecurrentNeuralNetwork.pro
+demo.makefile = Makefile.RecurrentNeuralNetwork
+server.file = rnnserver.pro
+server.makefile = Makefile.rnnserver
+loadgenerator.file = rnnloadgenerator.pro
+loadgenerator.makefile = Makefile.rnnloadgenerator
@@ -0,0 +1,42 @@
+#include "alignedmemory.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+void *alignedmemory::allocate(size_t size)
+{
+    if(size==0)
+        size=ALIGNEDMEMORY_ALIGNMENT;
+#ifdef _WIN32
+    return _aligned_malloc(size,ALIGNEDMEMORY_ALIGNMENT);
+#else
+    void *out;
+    if(posix_memalign(&out,ALIGNEDMEMORY_ALIGNMENT,size)!=0)
+        return 0;
+    return out;
+#endif
+}
+
+void *alignedmemory::allocateZeroed(size_t size)
+{
+    void *out=allocate(size);
+    if(out!=0)
+        memset(out,0,size);
+    return out;
+}
+
+void alignedmemory::release(void *data)
+{
+#ifdef _WIN32
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+uint32_t alignedmemory::paddedCount(uint32_t count, size_t elementSize)
+{
+    uint32_t elementsPerAlignment=(uint32_t)(ALIGNEDMEMORY_ALIGNMENT/elementSize);
+    return ((count+elementsPerAlignment-1)/elementsPerAlignment)*elementsPerAlignment;
+}
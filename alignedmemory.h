@@ -0,0 +1,19 @@
+#ifndef ALIGNEDMEMORY_H
+#define ALIGNEDMEMORY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGNEDMEMORY_ALIGNMENT 64 // Cache line size; also sufficient for AVX-512 loads/stores.
+
+class alignedmemory
+{
+public:
+    static void *allocate(size_t size); // The returned memory is ALIGNEDMEMORY_ALIGNMENT-byte-aligned and must be released using release().
+    static void *allocateZeroed(size_t size);
+    static void release(void *data);
+    static uint32_t paddedCount(uint32_t count,size_t elementSize); // Rounds "count" up so that "count*elementSize" is a multiple of ALIGNEDMEMORY_ALIGNMENT.
+};
+
+#endif // ALIGNEDMEMORY_H
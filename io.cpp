@@ -58,6 +58,24 @@ char *io::readZeroTerminatedData(char *&data)
     return out;
 }
 
+void io::readDoubleArray(char *&data, double *out, fs_t count)
+{
+    memcpy(out,data,count*sizeof(double));
+#ifdef IO_BIG_ENDIAN
+    reverseElementByteOrder((char*)out,sizeof(double),count);
+#endif
+    data+=count*sizeof(double);
+}
+
+void io::readFloatArray(char *&data, float *out, fs_t count)
+{
+    memcpy(out,data,count*sizeof(float));
+#ifdef IO_BIG_ENDIAN
+    reverseElementByteOrder((char*)out,sizeof(float),count);
+#endif
+    data+=count*sizeof(float);
+}
+
 uint8_t io::peekUInt8(char *data, fs_t pos)
 {
     return (uint8_t)data[pos++];
@@ -256,6 +274,24 @@ void io::writeRawData(char *data, const char *in, fs_t length, fs_t &pos)
 }
 
 
+void io::writeDoubleArray(char *data, const double *in, fs_t count, fs_t &pos)
+{
+    memcpy(data+pos,in,count*sizeof(double));
+#ifdef IO_BIG_ENDIAN
+    reverseElementByteOrder(data+pos,sizeof(double),count);
+#endif
+    pos+=count*sizeof(double);
+}
+
+void io::writeFloatArray(char *data, const float *in, fs_t count, fs_t &pos)
+{
+    memcpy(data+pos,in,count*sizeof(float));
+#ifdef IO_BIG_ENDIAN
+    reverseElementByteOrder(data+pos,sizeof(float),count);
+#endif
+    pos+=count*sizeof(float);
+}
+
 void io::putUInt8(char *data, uint8_t i, fs_t pos)
 {
     data[pos++]=i;
@@ -387,6 +423,20 @@ void io::writeRawDataToBuffer(char *&data, const char *in, fs_t length, fs_t &po
     writeRawData(data,in,length,pos);
 }
 
+void io::writeDoubleArrayToBuffer(char *&data, const double *in, fs_t count, fs_t &pos, fs_t &bufferSize)
+{
+    fs_t newPos=pos+count*sizeof(double);
+    bufferCheck(data,newPos,bufferSize);
+    writeDoubleArray(data,in,count,pos);
+}
+
+void io::writeFloatArrayToBuffer(char *&data, const float *in, fs_t count, fs_t &pos, fs_t &bufferSize)
+{
+    fs_t newPos=pos+count*sizeof(float);
+    bufferCheck(data,newPos,bufferSize);
+    writeFloatArray(data,in,count,pos);
+}
+
 void io::writeRawDataToLongBuffer(char *&data, const char *in, uint64_t length, uint64_t &pos, uint64_t &bufferSize)
 {
     fs_t newPos=pos+length;
@@ -427,6 +477,12 @@ void io::reverseByteOrder(char *data, fs_t length)
     }
 }
 
+void io::reverseElementByteOrder(char *data, fs_t elementSize, fs_t count)
+{
+    for(fs_t i=0;i<count;i++)
+        reverseByteOrder(data+i*elementSize,elementSize);
+}
+
 void io::terminateBuffer(char *&buffer, fs_t &pos, fs_t bufferSize)
 {
     bufferCheck(buffer,pos,bufferSize);
@@ -12,6 +12,11 @@
 
 #define extendBufferSize(bufferSize,pos) while(pos>=bufferSize) bufferSize*=2;
 
+// Byte order of the host; all data written by io is little-endian.
+#if defined(__BYTE_ORDER__)&&defined(__ORDER_BIG_ENDIAN__)&&__BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+#define IO_BIG_ENDIAN
+#endif
+
 class io
 {
 public:
@@ -23,6 +28,10 @@ public:
     static double readDouble(char *&data);
     static char *readFixedLengthData(char *&data,fs_t &length);
     static char *readZeroTerminatedData(char *&data);
+    // Raw IEEE-754 arrays (unlike readDouble(), which reads the integer/fraction encoding of writeDouble()). Lossless; one memcpy on
+    // little-endian hosts.
+    static void readDoubleArray(char *&data,double *out,fs_t count);
+    static void readFloatArray(char *&data,float *out,fs_t count);
 
     static uint8_t peekUInt8(char *data,fs_t pos);
     static uint16_t peekUInt16(char *data,fs_t pos);
@@ -50,6 +59,8 @@ public:
     static void writeFixedLengthData(char *data, fs_t length, const char *in, fs_t &pos);
     static void writeZeroTerminatedData(char *data, const char *in, fs_t &pos);
     static void writeRawData(char *data, const char *in, fs_t length, fs_t &pos);
+    static void writeDoubleArray(char *data, const double *in, fs_t count, fs_t &pos); // count*8 bytes; see readDoubleArray()
+    static void writeFloatArray(char *data, const float *in, fs_t count, fs_t &pos); // count*4 bytes
 
     static void putUInt8(char *data, uint8_t i, fs_t pos);
     static void putUInt16(char *data, uint16_t i, fs_t pos);
@@ -70,10 +81,13 @@ public:
     static void writeFixedLengthDataToBuffer(char *&data, fs_t length, const char *in, fs_t &pos, fs_t &bufferSize);
     static void writeZeroTerminatedDataToBuffer(char *&data, const char *in, fs_t &pos, fs_t &bufferSize);
     static void writeRawDataToBuffer(char *&data, const char *in, fs_t length, fs_t &pos, fs_t &bufferSize);
+    static void writeDoubleArrayToBuffer(char *&data, const double *in, fs_t count, fs_t &pos, fs_t &bufferSize);
+    static void writeFloatArrayToBuffer(char *&data, const float *in, fs_t count, fs_t &pos, fs_t &bufferSize);
     static void writeRawDataToLongBuffer(char *&data, const char *in, uint64_t length, uint64_t &pos, uint64_t &bufferSize);
     static void writeRawCharToBuffer(char *&data, unsigned char in, fs_t &pos, fs_t &bufferSize);
     static void writeRawCharToLongBuffer(char *&data, unsigned char in, uint64_t &pos, uint64_t &bufferSize);
     static void reverseByteOrder(char *data, fs_t length);
+    static void reverseElementByteOrder(char *data, fs_t elementSize, fs_t count); // reverseByteOrder() for every element of an array
 
     static void terminateBuffer(char *&buffer, fs_t &pos, fs_t bufferSize);
     static bool bufferCheck(char *&buffer,fs_t pos,fs_t &bufferSize);
@@ -10,10 +10,12 @@
 #include "text.h"
 
 #include "rnn.h"
+#include "rnncorpusreader.h"
+#include "rnngenerator.h"
 
 using namespace std;
 
-string doubleArrayToString(double *array,uint32_t elementCount,bool includeHighest)
+string doubleArrayToString(const rnnfloat_t *array,uint32_t elementCount,bool includeHighest)
 {
     string out;
     out+="[";
@@ -44,8 +46,87 @@ string doubleArrayToString(double *array,uint32_t elementCount,bool includeHighe
     return out;
 }
 
+void trainOnCorpus(const char *fileName)
+{
+    // Character-level training on a text file of any size, with the data prepared by a prefetch thread; see RNNCorpusReader.
+    const char *alphabet="\n !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
+    uint32_t batchSize=16;
+    uint32_t stepsPerBatch=64;
+    RNNCorpusReader *reader=new RNNCorpusReader(alphabet,batchSize,stepsPerBatch);
+    if(!reader->open(fileName))
+    {
+        cout<<"Cannot read "<<fileName<<endl;
+        delete reader;
+        return;
+    }
+    uint32_t symbolCount=reader->symbolCount;
+    uint32_t layerNeuronCounts[3]={0 /*Set by the RNN*/,128,symbolCount};
+    RNN *rnn=new RNN(symbolCount,symbolCount,15,0.01,0.9,0.0,3,layerNeuronCounts,batchSize);
+    rnn->outputType=outputSoftmax; // Next-symbol probabilities
+    rnn->setLearningInterval(rnn->stateArraySize); // Truncated BPTT over the streams
+    // Samples of the current model, starting after a line break
+    RNNGenerator *generator=new RNNGenerator(rnn);
+    generator->temperature=0.8;
+    generator->topP=0.95;
+    uint32_t startSymbol=reader->symbolIndices[(uint8_t)'\n'];
+    const uint32_t sampleLength=200;
+    uint32_t sampleSymbols[sampleLength];
+    char sampleText[sampleLength+1];
+
+    uint64_t correctCount=0;
+    uint64_t stepCount=0;
+    for(uint64_t batchIndex=1;;batchIndex++)
+    {
+        RNNCorpusBatch *batch=reader->nextBatch();
+        for(uint32_t step=0;step<stepsPerBatch;step++)
+        {
+            rnn->processIndexBatch(batch->inputIndices[step],0); // One-hot inputs
+            RNNState *state=rnn->getCurrentState();
+            for(uint32_t sequence=0;sequence<batchSize;sequence++)
+            {
+                const rnnfloat_t *output=state->getOutput(sequence);
+                uint32_t highestIndex=0;
+                for(uint32_t i=1;i<symbolCount;i++)
+                {
+                    if(output[i]>output[highestIndex])
+                        highestIndex=i;
+                }
+                if(highestIndex==batch->desiredOutputIndices[step][sequence])
+                    correctCount++;
+                stepCount++;
+            }
+            rnn->setDesiredOutputs(batch->desiredOutputs[step]); // Learns every k1 steps.
+        }
+        if(batchIndex%100==0)
+        {
+            char *str=text::doubleToStringWithFixedPrecision((double)correctCount/(double)stepCount*100.0,1);
+            cout<<"Next character accuracy: "<<str<<"%; "<<reader->getReport().toString()<<endl;
+            free(str);
+            correctCount=0;
+            stepCount=0;
+
+            generator->reset();
+            generator->feed(&startSymbol,1);
+            generator->generate(sampleSymbols,sampleLength);
+            for(uint32_t i=0;i<sampleLength;i++)
+                sampleText[i]=(char)reader->symbolBytes[sampleSymbols[i]];
+            sampleText[sampleLength]=0;
+            cout<<"Sample:"<<endl<<sampleText<<endl<<generator->getReport().toString()<<endl;
+        }
+    }
+    delete generator;
+    delete rnn;
+    delete reader;
+}
+
 int main(int argc, char *argv[])
 {
+    if(argc>1)
+    {
+        trainOnCorpus(argv[1]);
+        return 0;
+    }
+
     /*
     This implementation is a Jordan-type recurrent neural network.
     A computational step takes the current input data plus the output data of the last computational step (or zeroes, if it is the first step).
@@ -63,7 +144,11 @@ int main(int argc, char *argv[])
     RNN *rnn=new RNN(inputCount,effectiveOutputCount,backpropagationSteps,learningRate,momentum,weightDecay,2);
     uint64_t cycle=0;
     char *str;
-    double **desiredOutputs=(double**)malloc((backpropagationSteps+1)*sizeof(double*));
+    // All buffers are allocated once and reused for every step.
+    rnnfloat_t *input=(rnnfloat_t*)malloc(inputCount*sizeof(rnnfloat_t));
+    rnnfloat_t **desiredOutputs=(rnnfloat_t**)malloc((backpropagationSteps+1)*sizeof(rnnfloat_t*));
+    for(uint32_t i=0;i<backpropagationSteps+1;i++)
+        desiredOutputs[i]=(rnnfloat_t*)malloc(effectiveOutputCount*sizeof(rnnfloat_t));
     // Only call learn() after the last step!
 
     vector<int> accuracyVector;
@@ -71,7 +156,6 @@ int main(int argc, char *argv[])
 
     for(uint64_t current=0;/*current<10*/;current++)
     {
-        double *input=(double*)malloc(inputCount*sizeof(double));
         uint64_t currentPos=current%4; // o not used!
         if(currentPos==0)
         {
@@ -91,11 +175,10 @@ int main(int argc, char *argv[])
         free(str);
         for(uint32_t i=0;i<inputCount;i++)
             input[i]=(i==currentChar?1.0:0.0);
-        double *output;
-        output=rnn->process(input);
+        const rnnfloat_t *output=rnn->step(input); // Valid until the state is reused
         cout<<"Output:           "<<doubleArrayToString(output,outputCount /*Do not include the additional memory neurons*/,true)<<endl;
 
-        double *desiredOutput=(double*)malloc(effectiveOutputCount*sizeof(double));
+        rnnfloat_t *desiredOutput=desiredOutputs[currentPos];
         // Desired output: next char!
         uint8_t desiredOut;
         if(currentPos==0) // "h"
@@ -111,8 +194,6 @@ int main(int argc, char *argv[])
 
         cout<<"Desired output:   "<<doubleArrayToString(desiredOutput,outputCount /*Do not include the additional memory neurons*/,false)<<endl;
 
-        desiredOutputs[currentPos]=desiredOutput;
-
         uint8_t highestIndex=255;
         double highestValue=std::numeric_limits<double>::min();
         for(uint8_t i=0;i<effectiveOutputCount;i++)
@@ -144,18 +225,15 @@ int main(int argc, char *argv[])
         if(currentPos==3)
         {
             rnn->learn(desiredOutputs);
-            free(desiredOutputs[0]);
-            free(desiredOutputs[1]);
-            free(desiredOutputs[2]);
-            free(desiredOutputs[3]);
             cycle++;
         }
-        free(output);
-        free(input);
 
         cout<<endl;
     }
+    for(uint32_t i=0;i<backpropagationSteps+1;i++)
+        free(desiredOutputs[i]);
     free(desiredOutputs);
+    free(input);
     delete rnn;
 }
 
@@ -0,0 +1,101 @@
+#include "mappedfile.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    data=0;
+    size=0;
+#ifdef _WIN32
+    fileHandle=INVALID_HANDLE_VALUE;
+    mappingHandle=0;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *fileName)
+{
+    close();
+#ifdef _WIN32
+    fileHandle=CreateFileA(fileName,GENERIC_READ,FILE_SHARE_READ,0,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
+    if(fileHandle==INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(fileHandle,&fileSize))
+    {
+        close();
+        return false;
+    }
+    size=(uint64_t)fileSize.QuadPart;
+    if(size==0)
+        return true;
+    mappingHandle=CreateFileMappingA(fileHandle,0,PAGE_READONLY,0,0,0);
+    if(mappingHandle==0)
+    {
+        close();
+        return false;
+    }
+    data=(const char*)MapViewOfFile(mappingHandle,FILE_MAP_READ,0,0,0);
+#else
+    int fileDescriptor=::open(fileName,O_RDONLY);
+    if(fileDescriptor<0)
+        return false;
+    struct stat fileStatus;
+    if(fstat(fileDescriptor,&fileStatus)!=0)
+    {
+        ::close(fileDescriptor);
+        return false;
+    }
+    size=(uint64_t)fileStatus.st_size;
+    if(size==0)
+    {
+        ::close(fileDescriptor);
+        return true;
+    }
+    void *mapping=mmap(0,size,PROT_READ,MAP_SHARED,fileDescriptor,0);
+    ::close(fileDescriptor); // The mapping keeps the file open.
+    data=(mapping==MAP_FAILED?0:(const char*)mapping);
+#endif
+    if(data==0)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if(data!=0)
+        UnmapViewOfFile(data);
+    if(mappingHandle!=0)
+        CloseHandle(mappingHandle);
+    if(fileHandle!=INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+    fileHandle=INVALID_HANDLE_VALUE;
+    mappingHandle=0;
+#else
+    if(data!=0)
+        munmap((void*)data,size);
+#endif
+    data=0;
+    size=0;
+}
+
+void MappedFile::adviseSequential()
+{
+#ifndef _WIN32
+    if(data!=0)
+        posix_madvise((void*)data,size,POSIX_MADV_SEQUENTIAL);
+#endif
+}
@@ -0,0 +1,37 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+// Read-only memory mapping of a whole file. The pages are loaded on demand and live in the page cache, so all processes that map the same
+// file share one physical copy, and files larger than the RAM can be mapped (on 64-bit systems). The data starts at a page boundary.
+
+class MappedFile
+{
+public:
+    const char *data; // 0 if no file is mapped
+    uint64_t size;
+
+    bool open(const char *fileName); // False if the file couldn't be mapped; an empty file is mapped with data=0.
+    void close();
+    void adviseSequential(); // Hint: the data is read front to back (more read-ahead; pages behind are dropped sooner). No-op on Windows.
+
+    MappedFile();
+    ~MappedFile();
+
+private:
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,187 @@
+#include "quantizedrnn.h"
+
+std::string QuantizationReport::toString()
+{
+    std::string out;
+    char *str=text::unsignedIntToString(stepCount);
+    out+="Steps: ";
+    out+=str;
+    free(str);
+    str=text::doubleToString(maxAbsoluteError);
+    out+=", max. abs. error: ";
+    out+=str;
+    free(str);
+    str=text::doubleToString(meanAbsoluteError);
+    out+=", mean abs. error: ";
+    out+=str;
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(matchingHighestOutputRatio*100.0,2);
+    out+=", same highest output: ";
+    out+=str;
+    out+="%";
+    free(str);
+    str=text::unsignedLongToString(referenceParameterBytes);
+    out+=", parameters: ";
+    out+=str;
+    free(str);
+    str=text::unsignedLongToString(quantizedParameterBytes);
+    out+=" -> ";
+    out+=str;
+    out+=" bytes";
+    free(str);
+    return out;
+}
+
+QuantizedRNN::QuantizedRNN(RNN *rnn)
+{
+    RNNWeights *rnnWeights=rnn->weights;
+    inputCount=rnn->inputCount;
+    outputCount=rnn->outputCount;
+    kernelType=rnn->kernelType;
+    activationType=rnn->activationType;
+    outputType=rnn->outputType;
+    layerCount=rnn->layerCount;
+    size_t layerCountArraySize=layerCount*sizeof(uint32_t);
+    layerNeuronCounts=(uint32_t*)malloc(layerCountArraySize);
+    memcpy(layerNeuronCounts,rnn->layerNeuronCounts,layerCountArraySize);
+
+    uint32_t weightLayerCount=layerCount-1;
+    weightOffsets=(size_t*)malloc(weightLayerCount*sizeof(size_t));
+    weightRowStrides=(uint32_t*)malloc(weightLayerCount*sizeof(uint32_t));
+    weightRowScales=(rnnfloat_t**)malloc(weightLayerCount*sizeof(rnnfloat_t*));
+    biasWeights=(rnnfloat_t**)malloc(weightLayerCount*sizeof(rnnfloat_t*));
+    weightByteCount=0;
+    uint32_t maxRowStride=0;
+    for(uint32_t weightLayer=0;weightLayer<weightLayerCount;weightLayer++)
+    {
+        uint32_t rowStride=alignedmemory::paddedCount(layerNeuronCounts[weightLayer],sizeof(int8_t));
+        weightRowStrides[weightLayer]=rowStride;
+        weightOffsets[weightLayer]=weightByteCount;
+        weightByteCount+=(size_t)rowStride*layerNeuronCounts[weightLayer+1];
+        if(rowStride>maxRowStride)
+            maxRowStride=rowStride;
+    }
+    weights=(int8_t*)alignedmemory::allocateZeroed(weightByteCount);
+
+    for(uint32_t weightLayer=0;weightLayer<weightLayerCount;weightLayer++)
+    {
+        uint32_t neuronsInThisLayer=layerNeuronCounts[weightLayer];
+        uint32_t neuronsInNextLayer=layerNeuronCounts[weightLayer+1];
+        uint32_t nextLayerBasedArraySize=neuronsInNextLayer*sizeof(rnnfloat_t);
+        weightRowScales[weightLayer]=(rnnfloat_t*)malloc(nextLayerBasedArraySize);
+        biasWeights[weightLayer]=(rnnfloat_t*)malloc(nextLayerBasedArraySize);
+        memcpy(biasWeights[weightLayer],rnnWeights->getBiasWeights(weightLayer),nextLayerBasedArraySize);
+        for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInNextLayer;neuronInNextLayer++)
+            weightRowScales[weightLayer][neuronInNextLayer]=RNNKernels::quantizeValues(rnnWeights->getWeightRow(weightLayer,neuronInNextLayer),weights+weightOffsets[weightLayer]+(size_t)neuronInNextLayer*weightRowStrides[weightLayer],neuronsInThisLayer);
+    }
+
+    neuronValues=(rnnfloat_t**)malloc(layerCount*sizeof(rnnfloat_t*));
+    for(uint32_t thisLayer=0;thisLayer<layerCount;thisLayer++)
+        neuronValues[thisLayer]=(rnnfloat_t*)malloc(layerNeuronCounts[thisLayer]*sizeof(rnnfloat_t));
+    // Zeroed once: the part beyond the current layer's neuron count only ever meets zero weight padding.
+    quantizedValues=(int8_t*)alignedmemory::allocateZeroed(maxRowStride);
+    previousOutput=(rnnfloat_t*)malloc(outputCount*sizeof(rnnfloat_t));
+    setPreviousOutput(0);
+}
+
+QuantizedRNN::~QuantizedRNN()
+{
+    for(uint32_t weightLayer=0;weightLayer<layerCount-1;weightLayer++)
+    {
+        free(weightRowScales[weightLayer]);
+        free(biasWeights[weightLayer]);
+    }
+    for(uint32_t thisLayer=0;thisLayer<layerCount;thisLayer++)
+        free(neuronValues[thisLayer]);
+    free(neuronValues);
+    alignedmemory::release(quantizedValues);
+    free(previousOutput);
+    alignedmemory::release(weights);
+    free(weightOffsets);
+    free(weightRowStrides);
+    free(weightRowScales);
+    free(biasWeights);
+    free(layerNeuronCounts);
+}
+
+void QuantizedRNN::setPreviousOutput(const rnnfloat_t *_previousOutput)
+{
+    if(_previousOutput==0)
+    {
+        for(uint32_t i=0;i<outputCount;i++)
+            previousOutput[i]=0.0;
+    }
+    else
+        memcpy(previousOutput,_previousOutput,outputCount*sizeof(rnnfloat_t));
+}
+
+rnnfloat_t *QuantizedRNN::process(rnnfloat_t *input)
+{
+    rnnfloat_t *output=(rnnfloat_t*)malloc(outputCount*sizeof(rnnfloat_t));
+    process(input,output);
+    return output;
+}
+
+void QuantizedRNN::process(const rnnfloat_t *input, rnnfloat_t *output)
+{
+    // Effective input: input plus previous output
+    memcpy(neuronValues[0],input,inputCount*sizeof(rnnfloat_t));
+    memcpy(neuronValues[0]+inputCount,previousOutput,outputCount*sizeof(rnnfloat_t));
+
+    for(uint32_t thisLayer=0;thisLayer<layerCount-1 /*Do not include output layer*/;thisLayer++)
+    {
+        uint32_t neuronsInThisLayer=layerNeuronCounts[thisLayer];
+        rnnfloat_t valueScale=RNNKernels::quantizeValues(neuronValues[thisLayer],quantizedValues,neuronsInThisLayer);
+        bool isOutputLayer=(thisLayer+1==layerCount-1);
+        RNNKernels::layerForwardQuantized(kernelType,isOutputLayer&&outputType==outputSoftmax?activationNone:activationType,weights+weightOffsets[thisLayer],weightRowStrides[thisLayer],weightRowScales[thisLayer],biasWeights[thisLayer],
+                                          quantizedValues,valueScale,neuronsInThisLayer,neuronValues[thisLayer+1],layerNeuronCounts[thisLayer+1]);
+    }
+    if(outputType==outputSoftmax)
+        RNNActivation::softmaxArray(activationType,kernelType,neuronValues[layerCount-1],outputCount);
+
+    memcpy(previousOutput,neuronValues[layerCount-1],outputCount*sizeof(rnnfloat_t));
+    memcpy(output,previousOutput,outputCount*sizeof(rnnfloat_t));
+}
+
+QuantizationReport QuantizedRNN::compareWith(RNN *referenceRnn, rnnfloat_t **inputs, uint32_t stepCount)
+{
+    QuantizationReport report;
+    report.stepCount=stepCount;
+    report.maxAbsoluteError=0.0;
+    report.meanAbsoluteError=0.0;
+    report.matchingHighestOutputRatio=0.0;
+    report.referenceParameterBytes=referenceRnn->weights->parameterCount*sizeof(rnnfloat_t);
+    report.quantizedParameterBytes=weightByteCount;
+    for(uint32_t weightLayer=0;weightLayer<layerCount-1;weightLayer++)
+        report.quantizedParameterBytes+=2*layerNeuronCounts[weightLayer+1]*sizeof(rnnfloat_t);
+    if(stepCount==0)
+        return report; // Nothing compared; no errors
+
+    setPreviousOutput(referenceRnn->hasState(0)?referenceRnn->getCurrentState()->getOutput(0):0);
+    uint32_t matchingHighestOutputCount=0;
+    rnnfloat_t *output=(rnnfloat_t*)malloc(outputCount*sizeof(rnnfloat_t));
+    for(uint32_t step=0;step<stepCount;step++)
+    {
+        const rnnfloat_t *referenceOutput=referenceRnn->step(inputs[step]);
+        process(inputs[step],output);
+        uint32_t highestReferenceOutput=0;
+        uint32_t highestOutput=0;
+        for(uint32_t i=0;i<outputCount;i++)
+        {
+            double absoluteError=fabs((double)output[i]-(double)referenceOutput[i]);
+            if(absoluteError>report.maxAbsoluteError)
+                report.maxAbsoluteError=absoluteError;
+            report.meanAbsoluteError+=absoluteError;
+            if(referenceOutput[i]>referenceOutput[highestReferenceOutput])
+                highestReferenceOutput=i;
+            if(output[i]>output[highestOutput])
+                highestOutput=i;
+        }
+        if(highestOutput==highestReferenceOutput)
+            matchingHighestOutputCount++;
+    }
+    free(output);
+    report.meanAbsoluteError/=(double)stepCount*outputCount;
+    report.matchingHighestOutputRatio=(double)matchingHighestOutputCount/(double)stepCount;
+    return report;
+}
@@ -0,0 +1,71 @@
+#ifndef QUANTIZEDRNN_H
+#define QUANTIZEDRNN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "alignedmemory.h"
+#include "rnn.h"
+
+// Here, the input and output layers are meant to be included in "layerCount" and "layerNeuronCounts".
+
+// Result of QuantizedRNN::compareWith().
+struct QuantizationReport
+{
+    uint32_t stepCount;
+    double maxAbsoluteError; // Over all outputs of all steps
+    double meanAbsoluteError;
+    double matchingHighestOutputRatio; // Fraction of steps in which both networks have the same highest output
+    size_t referenceParameterBytes;
+    size_t quantizedParameterBytes; // Including the scales and bias weights
+
+    std::string toString();
+};
+
+// Inference-only copy of a trained RNN with int8 weights, for serving. Every weight row (all weights pointing to one neuron) has its own
+// scale. The values entering a layer are quantized to int8 with one scale per step, so the sums are computed in int32; bias weights, scales
+// and the values between layers stay in rnnfloat_t. Training the original RNN further does not affect the quantized copy.
+
+class QuantizedRNN
+{
+public:
+    // All int8 weights in one aligned block, with the same row layout as RNNWeights; rows are padded to ALIGNEDMEMORY_ALIGNMENT bytes.
+    int8_t *weights;
+    size_t *weightOffsets; // Dimensions: weight layers
+    uint32_t *weightRowStrides; // Dimensions: weight layers
+    // Dimensions: weight layers -> neurons in next layer
+    rnnfloat_t **weightRowScales;
+    rnnfloat_t **biasWeights;
+    size_t weightByteCount;
+
+    uint32_t *layerNeuronCounts;
+    uint32_t layerCount;
+    uint32_t inputCount;
+    uint32_t outputCount;
+
+    // Working memory of a single step; there is no history.
+    rnnfloat_t **neuronValues; // Dimensions: layers -> neuron values
+    int8_t *quantizedValues; // Quantized values of the layer that is being processed; padded and zeroed like the weight rows
+    rnnfloat_t *previousOutput;
+
+    RNNKernelType kernelType; // Taken from the RNN
+    RNNActivationType activationType; // Taken from the RNN
+    RNNOutputType outputType; // Taken from the RNN
+
+
+    // Equivalent to RNN::process()
+    rnnfloat_t *process(rnnfloat_t *input); // The returned output must be freed.
+    void process(const rnnfloat_t *input,rnnfloat_t *output);
+    void setPreviousOutput(const rnnfloat_t *_previousOutput); // 0: start a new sequence (zeroes, like a fresh RNN)
+
+    // Feeds the same inputs (Dimensions: steps -> values) to this network and to "referenceRnn", which must have a batch size of 1; both start
+    // from the current state of "referenceRnn", whose state history is advanced.
+    QuantizationReport compareWith(RNN *referenceRnn,rnnfloat_t **inputs,uint32_t stepCount);
+
+    QuantizedRNN(RNN *rnn);
+    ~QuantizedRNN();
+};
+
+#endif // QUANTIZEDRNN_H
@@ -3,16 +3,17 @@
 double RNN::sig(double input)
 {
     // Derivative: sig(input)*(1.0-sig(input))
-    return 1.0/(1.0+pow(M_E,-input));
+    return 1.0/(1.0+exp(-input));
 }
 
 double RNN::tanh(double input)
 {
     // Derivative: 1.0-pow(tanh(input),2.0)
-    return (1.0-pow(M_E,-2.0*input))/(1.0+pow(M_E,-2.0*input));
+    // For whole neuron arrays, use RNNActivation::tanhArray() instead.
+    return ::tanh(input);
 }
 
-RNN::RNN(uint32_t _inputCount, uint32_t _outputCount, uint32_t _backpropagationSteps, double _learningRate, double _momentum, double _weightDecay, uint32_t _layerCount, uint32_t *_layerNeuronCounts)
+RNN::RNN(uint32_t _inputCount, uint32_t _outputCount, uint32_t _backpropagationSteps, double _learningRate, double _momentum, double _weightDecay, uint32_t _layerCount, uint32_t *_layerNeuronCounts, uint32_t _batchSize, RNNWeights *_sharedWeights)
 {
     // Here, the input and output layers are meant to be included in "_layerCount" and "_layerNeuronCounts".
     inputCount=_inputCount;
@@ -23,7 +24,8 @@ RNN::RNN(uint32_t _inputCount, uint32_t _outputCount, uint32_t _backpropagationS
     momentum=_momentum;
     weightDecay=_weightDecay;
     layerCount=_layerCount;
-    if(_layerCount<2)
+    batchSize=_batchSize;
+    if(_layerCount<2||_batchSize==0)
         throw;
 
     layerNeuronCounts=(uint32_t*)malloc(layerCount*sizeof(uint32_t));
@@ -34,84 +36,141 @@ RNN::RNN(uint32_t _inputCount, uint32_t _outputCount, uint32_t _backpropagationS
     }
     else
     {
-        memcpy(layerNeuronCounts,_layerNeuronCounts,layerCount*sizeof(double));
+        memcpy(layerNeuronCounts,_layerNeuronCounts,layerCount*sizeof(uint32_t));
         layerNeuronCounts[0]=inputAndOutputCount; // Must have this size.
     }
 
-    stateArraySize=2*backpropagationSteps+1 /*One for the current state.*/;
+    // All state records are allocated up front and reused in a ring, so that stepping does not allocate.
+    stateArraySize=backpropagationSteps+1 /*One for the current state.*/;
     stateArrayPos=0xffffffff;
+    storedStateCount=0;
+    continuesSequence=false;
     states=(RNNState**)malloc(stateArraySize*sizeof(RNNState*));
-    previousWeightDiff=(double***)malloc((layerCount-1)*sizeof(double**));
-    previousBiasWeightDiff=(double**)malloc((layerCount-1)*sizeof(double*));
-
-    for(uint32_t thisLayer=1 /*Input layer not included*/;thisLayer<layerCount;thisLayer++)
+    for(uint32_t state=0;state<stateArraySize;state++)
+        states[state]=new RNNState(inputCount,outputCount,layerCount,layerNeuronCounts,batchSize);
+
+    kernelType=RNNKernels::detectBestKernelType();
+    learningInterval=0;
+    stepsSinceLearning=0;
+    forwardStepCount=0;
+    backwardStepCount=0;
+    threadTeam=0;
+    inferenceOnly=false;
+    activationType=activationFast;
+    outputType=outputTanh;
+    ownsWeights=(_sharedWeights==0);
+    if(ownsWeights)
     {
-        uint32_t weightLayerIndex=thisLayer-1;
-        uint32_t neuronsInPreviousLayer=layerNeuronCounts[thisLayer-1];
-        uint32_t neuronsInThisLayer=layerNeuronCounts[thisLayer];
-        previousWeightDiff[weightLayerIndex]=(double**)malloc(neuronsInPreviousLayer*sizeof(double*));
-        for(uint32_t neuronInPreviousLayer=0;neuronInPreviousLayer<neuronsInPreviousLayer;neuronInPreviousLayer++)
-        {
-            previousWeightDiff[weightLayerIndex][neuronInPreviousLayer]=(double*)malloc(neuronsInThisLayer*sizeof(double));
-            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
-                previousWeightDiff[weightLayerIndex][neuronInPreviousLayer][neuronInThisLayer]=0.0;
-        }
-        previousBiasWeightDiff[weightLayerIndex]=(double*)malloc(neuronsInThisLayer*sizeof(double));
-        for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
-            previousBiasWeightDiff[weightLayerIndex][neuronInThisLayer]=0.0;
+        weights=new RNNWeights(layerCount,layerNeuronCounts,true);
+        previousWeightDiff=new RNNWeights(layerCount,layerNeuronCounts,false); // Same layout as the weights, so they can be updated in one pass.
+    }
+    else
+    {
+        weights=_sharedWeights; // Must have been created for the same layer neuron counts.
+        previousWeightDiff=0;
     }
+
+    // Scratch memory for learning, sized once. The error terms have the same layout as the neuron values of a state.
+    accumulatedWeightDiff=ownsWeights?new RNNWeights(layerCount,layerNeuronCounts,false):0;
+    bottomDiff=(rnnfloat_t*)malloc(batchSize*outputCount*sizeof(rnnfloat_t));
+    sparseBiasWeights=(rnnfloat_t*)malloc(layerNeuronCounts[1]*sizeof(rnnfloat_t));
+    nonZeroInputIndices=(uint32_t*)malloc(inputCount*sizeof(uint32_t));
+    sparseUpdates=false;
+    touchedInputIndices=0;
+    touchedInputCount=0;
+    isInputTouched=0;
+    inputLastUpdates=0;
+    touchedInputDecayFactors=0;
+    sparseUpdateCount=0;
+    errorTerms=(rnnfloat_t**)malloc((layerCount-1)*sizeof(rnnfloat_t*));
+    size_t errorTermCount=0;
+    for(uint32_t thisLayer=1;thisLayer<layerCount;thisLayer++)
+        errorTermCount+=(size_t)states[0]->neuronValueStrides[thisLayer]*batchSize;
+    errorTerms[0]=(rnnfloat_t*)alignedmemory::allocate(errorTermCount*sizeof(rnnfloat_t));
+    for(uint32_t thisLayer=2;thisLayer<layerCount;thisLayer++)
+        errorTerms[thisLayer-1]=errorTerms[thisLayer-2]+(size_t)states[0]->neuronValueStrides[thisLayer-1]*batchSize;
 }
 
 RNN::~RNN()
 {
-    for(uint32_t layer=stateArrayPos-backpropagationSteps;layer<=stateArrayPos;layer++)
-        delete states[layer];
+    for(uint32_t state=0;state<stateArraySize;state++)
+        delete states[state];
     free(states);
     free(layerNeuronCounts);
+    if(ownsWeights)
+        delete weights;
+    delete previousWeightDiff; // Can also exist for shared weights (Hogwild mode of RNNTrainer).
+    delete accumulatedWeightDiff;
+    free(bottomDiff);
+    free(sparseBiasWeights);
+    free(nonZeroInputIndices);
+    free(touchedInputIndices);
+    free(isInputTouched);
+    free(inputLastUpdates);
+    free(touchedInputDecayFactors);
+    if(errorTerms!=0)
+        alignedmemory::release(errorTerms[0]);
+    free(errorTerms);
+}
 
-    for(uint32_t thisLayer=1 /*Input layer not included*/;thisLayer<layerCount;thisLayer++)
+void RNN::setInferenceOnly()
+{
+    if(inferenceOnly)
+        return;
+    inferenceOnly=true;
+    RNNState *currentState=storedStateCount>0?getCurrentState():states[0];
+    for(uint32_t state=0;state<stateArraySize;state++)
     {
-        uint32_t layerNonInputLayerIndex=thisLayer-1;
-        uint32_t neuronsInPreviousLayer=layerNeuronCounts[thisLayer-1];
-
-        for(uint32_t neuronInPreviousLayer;neuronInPreviousLayer<neuronsInPreviousLayer;neuronInPreviousLayer++)
-            free(previousWeightDiff[layerNonInputLayerIndex][neuronInPreviousLayer]);
-        free(previousBiasWeightDiff[layerNonInputLayerIndex]);
-        free(previousWeightDiff[layerNonInputLayerIndex]);
+        if(states[state]!=currentState)
+            delete states[state];
     }
-    free(previousWeightDiff);
-    free(previousBiasWeightDiff);
+    states[0]=currentState;
+    stateArraySize=1;
+    if(storedStateCount>0)
+    {
+        stateArrayPos=0;
+        storedStateCount=1;
+    }
+    backpropagationSteps=0;
+    learningInterval=0;
+    stepsSinceLearning=0;
+
+    delete previousWeightDiff;
+    previousWeightDiff=0;
+    delete accumulatedWeightDiff;
+    accumulatedWeightDiff=0;
+    free(bottomDiff);
+    bottomDiff=0;
+    free(nonZeroInputIndices);
+    nonZeroInputIndices=0;
+    free(touchedInputIndices);
+    touchedInputIndices=0;
+    free(isInputTouched);
+    isInputTouched=0;
+    free(inputLastUpdates);
+    inputLastUpdates=0;
+    free(touchedInputDecayFactors);
+    touchedInputDecayFactors=0;
+    sparseUpdates=false;
+    alignedmemory::release(errorTerms[0]);
+    free(errorTerms);
+    errorTerms=0;
 }
 
 RNNState *RNN::pushState()
 {
-    // This works as follows: the buffer is larger (usually 2 times larger) than the required size, allowing us to avoid having to move memory
-    // every time a new state is pushed. Once the buffer is filled, the needed elements in the front are moved back, overriding the old states
-    // that aren't needed anymore, and creating room for new states to be pushed.
+    // The states form a ring: the new state overwrites the oldest one, which isn't needed anymore once the ring is full.
+    // Only the activations are stored per step; the weights are shared.
 
-    if(stateArrayPos==0xffffffff)
-        stateArrayPos=0; // Do not increment the position the first time pushLayerState() is called.
+    if(stateArrayPos==0xffffffff||stateArrayPos==stateArraySize-1)
+        stateArrayPos=0;
     else
-    {
-        if(stateArrayPos==stateArraySize-1)
-        {
-            // Overwrite old states that aren't needed anymore, and set the new position:
-            // Note that the current state will be a backpropagation state after the new state is pushed to the array.
-            delete states[stateArrayPos-backpropagationSteps]; // Delete unneeded state
-            memcpy(states,states+(stateArraySize-backpropagationSteps),backpropagationSteps*sizeof(RNNState*));
-            stateArrayPos=backpropagationSteps-1;
-        }
         stateArrayPos++;
-    }
-    // Copy values from previous state, if such a state exists:
-    RNNState *newState=stateArrayPos>0/*Has previous state?*/?new RNNState(getState(1)):new RNNState(0,inputCount,outputCount,layerCount,layerNeuronCounts);
-    states[stateArrayPos]=newState;
-    if(stateArrayPos>backpropagationSteps)
-    {
-        // Free memory occupied by the now unneeded state (each time a new state is pushed, the memory occupied by the oldest state, which is
-        // not needed anymore from that point on, is freed):
-        delete states[stateArrayPos-backpropagationSteps-1];
-    }
+    continuesSequence=(storedStateCount>0);
+    if(storedStateCount<stateArraySize)
+        storedStateCount++;
+    states[stateArrayPos]->hasDesiredOutputs=false;
+    forwardStepCount++;
     return states[stateArrayPos];
 }
 
@@ -120,81 +179,334 @@ RNNState *RNN::getCurrentState()
     return states[stateArrayPos];
 }
 
+void RNN::startNewSequence()
+{
+    storedStateCount=0;
+    stepsSinceLearning=0;
+}
+
 bool RNN::hasState(uint32_t stepsBack)
 {
-    return stateArrayPos!=0xffffffff&&stepsBack<=__min(backpropagationSteps,stateArrayPos);
+    return stepsBack<storedStateCount;
 }
 
 uint32_t RNN::getAvailableStepsBack()
 {
-    return stateArrayPos!=0xffffffff?__min(backpropagationSteps,stateArrayPos):0;
+    return storedStateCount>0?storedStateCount-1:0;
 }
 
 RNNState *RNN::getState(uint32_t stepsBack)
 {
-    return states[stateArrayPos-stepsBack];
+    // stepsBack<stateArraySize is required.
+    return states[stateArrayPos>=stepsBack?stateArrayPos-stepsBack:stateArrayPos+stateArraySize-stepsBack];
 }
 
-double *RNN::process(double *input)
+rnnfloat_t *RNN::process(rnnfloat_t *input)
 {
-    // Effective input: input plus previous output.
+    rnnfloat_t *output=(rnnfloat_t*)malloc(outputCount*sizeof(rnnfloat_t));
+    process(input,output);
+    return output;
+}
+
+void RNN::process(const rnnfloat_t *input, rnnfloat_t *output)
+{
+    if(batchSize!=1)
+        throw; // Use processBatch().
+    processBatch(&input,&output);
+}
+
+const rnnfloat_t *RNN::step(const rnnfloat_t *input)
+{
+    if(batchSize!=1)
+        throw; // Use processBatch().
+    processBatch(&input,0);
+    return getCurrentState()->getOutput(0);
+}
+
+void RNN::processBatch(const rnnfloat_t *const *inputs, rnnfloat_t **outputs)
+{
+    // Effective input: input plus previous output, for every sequence. Both are written to the input layer directly.
     RNNState *newState=pushState();
-    bool hasPreviousState=hasState(1);
-    RNNState *previousState=hasPreviousState?getState(1):0;
-    uint32_t inputCountBasedDoubleArraySize=inputCount*sizeof(double);
-    uint32_t outputCountBasedDoubleArraySize=outputCount*sizeof(double);
-    memcpy(newState->input,input,inputCountBasedDoubleArraySize);
-    memcpy(newState->neuronValues[0],input,inputCountBasedDoubleArraySize);
-    if(hasPreviousState)
-    {
-        memcpy(newState->previousOutput,previousState->output,outputCountBasedDoubleArraySize);
-        memcpy(newState->neuronValues[0]+inputCount,previousState->output,outputCountBasedDoubleArraySize);
-    }
-    else
+    uint32_t inputCountBasedDoubleArraySize=inputCount*sizeof(rnnfloat_t);
+    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        memcpy(newState->getInput(sequence),inputs[sequence],inputCountBasedDoubleArraySize);
+    copyPreviousOutputs(newState);
+    forwardPass(newState,0,batchSize);
+    copyOutputs(newState,outputs);
+}
+
+void RNN::processSparseBatch(const uint32_t *const *inputIndices, const rnnfloat_t *const *inputValues, const uint32_t *inputValueCounts, rnnfloat_t **outputs)
+{
+    RNNState *newState=pushState();
+    copyPreviousOutputs(newState);
+    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        sparseFirstLayerForward(newState,sequence,inputIndices[sequence],inputValues!=0?inputValues[sequence]:0,inputValueCounts[sequence]);
+    forwardPass(newState,1,batchSize);
+    copyOutputs(newState,outputs);
+}
+
+void RNN::processIndexBatch(const uint32_t *inputIndices, rnnfloat_t **outputs)
+{
+    RNNState *newState=pushState();
+    copyPreviousOutputs(newState);
+    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        sparseFirstLayerForward(newState,sequence,inputIndices+sequence,0,1);
+    forwardPass(newState,1,batchSize);
+    copyOutputs(newState,outputs);
+}
+
+void RNN::sparseFirstLayerForward(RNNState *state, uint32_t sequence, const uint32_t *inputIndices, const rnnfloat_t *inputValues, uint32_t inputValueCount)
+{
+    // The dense part of the first layer starts at the aligned column at or below the previous output, so that the vectorized kernels can be
+    // used for it; listed inputs in front of it are gathered into the bias weights, the others are part of it. The whole input layer is
+    // stored anyway (for learning), which is cheap compared to a product with it.
+    uint32_t valuesPerAlignment=ALIGNEDMEMORY_ALIGNMENT/sizeof(rnnfloat_t);
+    uint32_t denseStart=inputCount/valuesPerAlignment*valuesPerAlignment;
+    uint32_t neuronsInNextLayer=layerNeuronCounts[1];
+    rnnfloat_t *input=state->getInput(sequence);
+    memset(input,0,inputCount*sizeof(rnnfloat_t));
+    memcpy(sparseBiasWeights,weights->getBiasWeights(0),neuronsInNextLayer*sizeof(rnnfloat_t));
+    for(uint32_t i=0;i<inputValueCount;i++)
     {
-        // Initialize neuron values with zeroes (needed).
-        for(uint32_t i=0;i<outputCount;i++)
+        uint32_t inputIndex=inputIndices[i];
+        rnnfloat_t inputValue=(inputValues!=0?inputValues[i]:1.0);
+        if(inputIndex>=inputCount)
+            throw;
+        input[inputIndex]=inputValue;
+        if(inputIndex<denseStart)
         {
-            newState->previousOutput[i]=0.0;
-            newState->neuronValues[0][inputCount+i]=0.0;
+            for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInNextLayer;neuronInNextLayer++)
+                sparseBiasWeights[neuronInNextLayer]+=inputValue*weights->getWeight(0,inputIndex,neuronInNextLayer);
         }
     }
-    double *output=(double*)malloc(outputCountBasedDoubleArraySize);
-    for(uint32_t thisLayer=0;thisLayer<layerCount-1 /*Do not include output layer*/;thisLayer++)
+    RNNKernels::layerForward(kernelType,getActivationType(1),weights->getWeightRow(0,0)+denseStart,weights->weightRowStrides[0],sparseBiasWeights,input+denseStart,
+                             layerNeuronCounts[0]-denseStart,state->getNeuronValues(1,sequence),neuronsInNextLayer);
+}
+
+const rnnfloat_t *RNN::stepIndex(uint32_t inputIndex)
+{
+    if(batchSize!=1)
+        throw; // Use processIndexBatch().
+    processIndexBatch(&inputIndex,0);
+    return getCurrentState()->getOutput(0);
+}
+
+void RNN::processSessions(RNNSession *const *sessions, uint32_t sessionCount, const rnnfloat_t *const *inputs, rnnfloat_t **outputs)
+{
+    RNNState *newState=beginSessionStep(sessions,sessionCount);
+    for(uint32_t sequence=0;sequence<sessionCount;sequence++)
+        memcpy(newState->getInput(sequence),inputs[sequence],inputCount*sizeof(rnnfloat_t));
+    forwardPass(newState,0,sessionCount);
+    endSessionStep(newState,sessions,sessionCount,outputs);
+}
+
+void RNN::processSessionIndices(RNNSession *const *sessions, uint32_t sessionCount, const uint32_t *inputIndices, rnnfloat_t **outputs)
+{
+    RNNState *newState=beginSessionStep(sessions,sessionCount);
+    for(uint32_t sequence=0;sequence<sessionCount;sequence++)
+        sparseFirstLayerForward(newState,sequence,inputIndices+sequence,0,1);
+    forwardPass(newState,1,sessionCount);
+    endSessionStep(newState,sessions,sessionCount,outputs);
+}
+
+const rnnfloat_t *RNN::stepSession(RNNSession *session, const rnnfloat_t *input)
+{
+    processSessions(&session,1,&input,0);
+    return getCurrentState()->getOutput(0);
+}
+
+RNNState *RNN::beginSessionStep(RNNSession *const *sessions, uint32_t sessionCount)
+{
+    if(sessionCount>batchSize)
+        throw;
+    RNNState *newState=pushState();
+    for(uint32_t sequence=0;sequence<sessionCount;sequence++)
     {
-        uint32_t neuronsInThisLayer=layerNeuronCounts[thisLayer];
-        uint32_t neuronsInNextLayer=layerNeuronCounts[thisLayer+1];
+        RNNSession *session=sessions[sequence];
+        if(session->outputCount!=outputCount)
+            throw; // Created for another model
+        rnnfloat_t *previousOutput=newState->getPreviousOutput(sequence);
+        if(session->hasPreviousOutput)
+            memcpy(previousOutput,session->previousOutput,outputCount*sizeof(rnnfloat_t));
+        else
+            memset(previousOutput,0,outputCount*sizeof(rnnfloat_t));
+    }
+    return newState;
+}
 
-        for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInNextLayer;neuronInNextLayer++)
+void RNN::endSessionStep(RNNState *state, RNNSession *const *sessions, uint32_t sessionCount, rnnfloat_t **outputs)
+{
+    for(uint32_t sequence=0;sequence<sessionCount;sequence++)
+    {
+        RNNSession *session=sessions[sequence];
+        memcpy(session->previousOutput,state->getOutput(sequence),outputCount*sizeof(rnnfloat_t));
+        session->hasPreviousOutput=true;
+        session->stepCount++;
+        if(outputs!=0)
+            memcpy(outputs[sequence],session->previousOutput,outputCount*sizeof(rnnfloat_t));
+    }
+}
+
+void RNN::copyPreviousOutputs(RNNState *newState, const uint32_t *previousSequences)
+{
+    // Without a history (a single state record), the previous output is still in the record that is being reused; its output layer is
+    // only overwritten after the input layer has been filled.
+    bool hasPreviousState=continuesSequence;
+    RNNState *previousState=hasPreviousState?(stateArraySize>1?getState(1):newState):0;
+    uint32_t outputCountBasedDoubleArraySize=outputCount*sizeof(rnnfloat_t);
+    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+    {
+        rnnfloat_t *previousOutput=newState->getPreviousOutput(sequence);
+        if(hasPreviousState)
+            memcpy(previousOutput,previousState->getOutput(previousSequences!=0?previousSequences[sequence]:sequence),outputCountBasedDoubleArraySize);
+        else
         {
-            double thisLayerNeuronValueMultipliedByWeightSum=0.0;
-            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
-            {
-                double valueOfNeuronInThisLayer=newState->neuronValues[thisLayer][neuronInThisLayer];
-                thisLayerNeuronValueMultipliedByWeightSum+=newState->weights[thisLayer /*Input layer not included; effectively thisLayer-1+1*/][neuronInThisLayer][neuronInNextLayer]*valueOfNeuronInThisLayer;
-            }
-            double newNeuronValue=tanh(thisLayerNeuronValueMultipliedByWeightSum+newState->biasWeights[thisLayer/*The input layer has no bias weights, so this is thisLayer+1-1*/][neuronInNextLayer]);
-            newState->neuronValues[thisLayer+1][neuronInNextLayer]=newNeuronValue;
+            // Initialize neuron values with zeroes (needed).
+            for(uint32_t i=0;i<outputCount;i++)
+                previousOutput[i]=0.0;
         }
     }
+}
 
-    memcpy(newState->output,newState->neuronValues[layerCount-1],outputCountBasedDoubleArraySize);
-    memcpy(output,newState->neuronValues[layerCount-1],outputCountBasedDoubleArraySize);
-    return output;
+void RNN::forwardPass(RNNState *state, uint32_t firstLayer, uint32_t sequenceCount)
+{
+    for(uint32_t thisLayer=firstLayer;thisLayer<layerCount-1 /*Do not include output layer*/;thisLayer++)
+    {
+        RNNLayerForwardTask task;
+        task.rnn=this;
+        task.state=state;
+        task.thisLayer=thisLayer;
+        task.sequenceCount=sequenceCount;
+        if(threadTeam!=0&&layerNeuronCounts[thisLayer+1]>=RNN_MIN_NEURONS_PER_THREAD*threadTeam->threadCount)
+            threadTeam->run(&layerForwardTask,&task); // Returns when the whole layer is done.
+        else
+            layerForwardTask(&task,0,1);
+    }
+    if(outputType==outputSoftmax)
+    {
+        for(uint32_t sequence=0;sequence<sequenceCount;sequence++)
+            RNNActivation::softmaxArray(activationType,kernelType,state->getNeuronValues(layerCount-1,sequence),outputCount);
+    }
+}
+
+RNNActivationType RNN::getActivationType(uint32_t thisLayer)
+{
+    // The softmax is applied to the whole output layer afterwards.
+    return (thisLayer==layerCount-1&&outputType==outputSoftmax)?activationNone:activationType;
+}
+
+void RNN::copyOutputs(RNNState *state, rnnfloat_t **outputs)
+{
+    if(outputs==0)
+        return;
+    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        memcpy(outputs[sequence],state->getOutput(sequence),outputCount*sizeof(rnnfloat_t));
+}
+
+void RNN::layerForwardTask(void *context, uint32_t threadIndex, uint32_t threadCount)
+{
+    // Computes this thread's part of the neurons in the next layer; the parts start at multiples of four rows, the tile height of the kernels.
+    RNNLayerForwardTask *task=(RNNLayerForwardTask*)context;
+    RNN *rnn=task->rnn;
+    RNNState *state=task->state;
+    uint32_t thisLayer=task->thisLayer;
+    uint32_t neuronsInThisLayer=rnn->layerNeuronCounts[thisLayer];
+    uint32_t firstNeuronInNextLayer,endNeuronInNextLayer;
+    RNNThreadTeam::getRange(rnn->layerNeuronCounts[thisLayer+1],4,threadIndex,threadCount,firstNeuronInNextLayer,endNeuronInNextLayer);
+    if(firstNeuronInNextLayer==endNeuronInNextLayer)
+        return;
+    RNNKernels::layerForwardBatch(rnn->kernelType,rnn->getActivationType(thisLayer+1),rnn->weights->getWeightRow(thisLayer /*Input layer not included; effectively thisLayer-1+1*/,firstNeuronInNextLayer),
+                                  rnn->weights->weightRowStrides[thisLayer],rnn->weights->getBiasWeights(thisLayer /*The input layer has no bias weights, so this is thisLayer+1-1*/)+firstNeuronInNextLayer,
+                                  state->neuronValues[thisLayer],neuronsInThisLayer,state->neuronValues[thisLayer+1]+firstNeuronInNextLayer,state->neuronValueStrides[thisLayer+1],
+                                  endNeuronInNextLayer-firstNeuronInNextLayer,task->sequenceCount);
+}
+
+void RNN::learn(rnnfloat_t **desiredOutputs)
+{
+    if(batchSize!=1)
+        throw; // Use learnBatch().
+    learnBatch(&desiredOutputs);
+}
+
+void RNN::learnBatch(rnnfloat_t ***desiredOutputs)
+{
+    storeDesiredOutputs(desiredOutputs);
+    learnFromStoredDesiredOutputs(getAvailableStepsBack()+1);
 }
 
-void RNN::learn(double **desiredOutputs)
+void RNN::storeDesiredOutputs(rnnfloat_t ***desiredOutputs)
 {
     uint32_t availableStepsBack=getAvailableStepsBack();
-    // Dimensions: layers -> neurons in this layer -> neurons in next layer
-    double ***weightDiff=(double***)malloc((layerCount-1)*sizeof(double**));
-    // Dimensions: layers -> neurons in layer
-    double **biasDiff=(double**)malloc(layerCount*sizeof(double*));
+    for(uint32_t stepsBack=0;stepsBack<=availableStepsBack;stepsBack++)
+    {
+        RNNState *thisState=getState(stepsBack);
+        for(uint32_t sequence=0;sequence<batchSize;sequence++)
+            memcpy(thisState->getDesiredOutput(sequence),desiredOutputs[sequence][availableStepsBack-stepsBack],outputCount*sizeof(rnnfloat_t));
+        thisState->hasDesiredOutputs=true;
+    }
+}
 
-    double *bottomDiff=(double*)malloc(outputCount*sizeof(double)); // Derivatives of the loss function w.r.t. the previous outputs; does not need to be initialized.
+void RNN::setDesiredOutput(const rnnfloat_t *desiredOutput)
+{
+    if(batchSize!=1)
+        throw; // Use setDesiredOutputs().
+    setDesiredOutputs(&desiredOutput);
+}
 
-    RNNState *latestState=getCurrentState();
-    bool weightsAllocated=false;
+void RNN::setDesiredOutputs(const rnnfloat_t *const *desiredOutputs)
+{
+    RNNState *currentState=getCurrentState();
+    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        memcpy(currentState->getDesiredOutput(sequence),desiredOutputs[sequence],outputCount*sizeof(rnnfloat_t));
+    currentState->hasDesiredOutputs=true;
+
+    if(learningInterval==0)
+        return;
+    stepsSinceLearning++;
+    if(stepsSinceLearning>=learningInterval)
+    {
+        learnFromStoredDesiredOutputs(learningInterval);
+        stepsSinceLearning=0;
+    }
+}
+
+void RNN::setLearningInterval(uint32_t _learningInterval)
+{
+    if(inferenceOnly)
+        throw;
+    if(_learningInterval>stateArraySize)
+        throw; // The desired outputs of older steps would be gone (k1<=k2 is required).
+    learningInterval=_learningInterval;
+    stepsSinceLearning=0;
+}
+
+void RNN::learnFromStoredDesiredOutputs(uint32_t errorStepCount)
+{
+    // Derivatives of the loss function w.r.t. all weights and bias weights, summed over all steps and sequences
+    if(accumulatedWeightDiff==0)
+        throw; // Shares the weights of another RNN; use computeGradients().
+    if(weights->readOnly)
+        throw; // E.g. mapped from a model file
+    if(sparseUpdates)
+    {
+        // applySparseGradients() leaves the gradients at zero.
+        computeGradients(accumulatedWeightDiff,errorStepCount);
+        applySparseGradients(accumulatedWeightDiff);
+        return;
+    }
+    accumulatedWeightDiff->clear();
+    computeGradients(accumulatedWeightDiff,errorStepCount);
+    applyGradients(accumulatedWeightDiff,0,accumulatedWeightDiff->parameterCount);
+}
+
+void RNN::computeGradients(RNNWeights *weightDiff, uint32_t errorStepCount)
+{
+    if(inferenceOnly)
+        throw;
+    uint32_t availableStepsBack=getAvailableStepsBack();
+    backwardStepCount+=availableStepsBack+1;
+
+    // bottomDiff and errorTerms are scratch memory of this RNN; bottomDiff does not need to be initialized.
 
     // This will cycle totalStepCount times, but we need to go backwards, so we use "stepsBack" in combination with "getState(stepsBack)".
 
@@ -202,116 +514,284 @@ void RNN::learn(double **desiredOutputs)
     {
         // 0 = current state
         RNNState *thisState=getState(stepsBack);
-        double **errorTerms=(double**)malloc((layerCount-1)*sizeof(double*)); // The input layer has no error terms.
-
         for(uint32_t thisLayer=layerCount-1;thisLayer>0;thisLayer--) // Input layer not included.
         {
             uint32_t neuronsInThisLayer=layerNeuronCounts[thisLayer];
             uint32_t neuronsInPreviousLayer=layerNeuronCounts[thisLayer-1];
             uint32_t neuronsInNextLayer=thisLayer==layerCount-1?0:layerNeuronCounts[thisLayer+1];
-            errorTerms[thisLayer-1 /*Input layer not included*/]=(double*)malloc(neuronsInThisLayer*sizeof(double));
-            if(!weightsAllocated)
+            uint32_t errorTermStride=thisState->neuronValueStrides[thisLayer];
+            rnnfloat_t *layerErrorTerms=errorTerms[thisLayer-1 /*Input layer not included*/];
+
+            // Calculate the derivative of the loss function w.r.t the value inside the tanh function of each neuron ("error term"):
+
+            if(thisLayer==layerCount-1)
             {
-                weightDiff[thisLayer-1 /*Input layer not included*/]=(double**)malloc(neuronsInPreviousLayer*sizeof(double*));
-                biasDiff[thisLayer-1 /*Input layer not included*/]=(double*)malloc(neuronsInThisLayer*sizeof(double));
+                // Only the newest "errorStepCount" steps with desired outputs contribute an error of their own; older steps only pass on
+                // the errors of later steps.
+                bool hasOwnError=stepsBack<errorStepCount&&thisState->hasDesiredOutputs;
+                for(uint32_t sequence=0;sequence<batchSize;sequence++)
+                {
+                    if(outputType==outputSoftmax)
+                    {
+                        // Error terms of the logits, including the softmax derivative
+                        RNNActivation::softmaxErrorTerms(thisState->getNeuronValues(thisLayer,sequence),hasOwnError?thisState->getDesiredOutput(sequence):0,
+                                                         stepsBack>0?bottomDiff+sequence*outputCount:0,layerErrorTerms+(size_t)sequence*errorTermStride,neuronsInThisLayer);
+                        continue;
+                    }
+                    rnnfloat_t *desiredOutput=thisState->getDesiredOutput(sequence);
+                    rnnfloat_t *valuesOfNeuronsInThisLayer=thisState->getNeuronValues(thisLayer,sequence);
+                    rnnfloat_t *sequenceErrorTerms=layerErrorTerms+(size_t)sequence*errorTermStride;
+                    rnnfloat_t *sequenceBottomDiff=bottomDiff+sequence*outputCount;
+                    for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
+                    {
+                        rnnfloat_t outputValue=valuesOfNeuronsInThisLayer[neuronInThisLayer]; // Output value of this neuron
+                        // Bottom diff value: derivative of the loss function w.r.t. the value of this neuron
+                        rnnfloat_t bottomDiffValue=(stepsBack>0?sequenceBottomDiff[neuronInThisLayer]:0.0);
+                        sequenceErrorTerms[neuronInThisLayer]=(hasOwnError?desiredOutput[neuronInThisLayer]-outputValue:0.0)+bottomDiffValue;
+                    }
+                }
             }
-            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
+            else
             {
-                // Calculate the derivative of the loss function w.r.t the value inside the tanh function of this neuron ("error term"):
-
-                double outputValue=thisState->neuronValues[thisLayer][neuronInThisLayer]; // Output value of this neuron
-                double sumOfErrorTermsMultipliedByWeightsInNextLayer=0.0;
-                if(!weightsAllocated)
-                    biasDiff[thisLayer-1 /*Input layer not included*/][neuronInThisLayer]=0.0;
-                for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInNextLayer;neuronInNextLayer++)
+                // Sum up the error terms of the next layer multiplied by the weights pointing to them. This walks the weight rows
+                // contiguously instead of gathering one weight per row for every neuron in this layer; each row is applied to all sequences.
+                rnnfloat_t *errorTermsOfNextLayer=errorTerms[thisLayer /*Input layer not included; effectively thisLayer-1+1*/];
+                uint32_t nextLayerErrorTermStride=thisState->neuronValueStrides[thisLayer+1];
+                for(uint32_t sequence=0;sequence<batchSize;sequence++)
                 {
-                    double errorTermOfNeuronInNextLayer=errorTerms[thisLayer /*Input layer not included; effectively thisLayer-1+1*/][neuronInNextLayer];
-                    sumOfErrorTermsMultipliedByWeightsInNextLayer+=thisState->weights[thisLayer /*Input layer not included; effectively thisLayer-1+1*/][neuronInThisLayer][neuronInNextLayer]*errorTermOfNeuronInNextLayer;
+                    rnnfloat_t *sequenceErrorTerms=layerErrorTerms+(size_t)sequence*errorTermStride;
+                    for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
+                        sequenceErrorTerms[neuronInThisLayer]=0.0;
                 }
-                double errorTerm;
-                if(thisLayer==layerCount-1)
+                for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInNextLayer;neuronInNextLayer++)
                 {
-                    // Bottom diff value: derivative of the loss function w.r.t. the value of this neuron
-                    double bottomDiffValue=(stepsBack>0?bottomDiff[neuronInThisLayer]:0.0);
-                    errorTerm=(1.0-pow(outputValue,2))*((desiredOutputs[availableStepsBack-stepsBack][neuronInThisLayer]-outputValue)+bottomDiffValue);
+                    rnnfloat_t *weightRow=weights->getWeightRow(thisLayer /*Input layer not included; effectively thisLayer-1+1*/,neuronInNextLayer);
+                    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+                    {
+                        rnnfloat_t errorTermOfNeuronInNextLayer=errorTermsOfNextLayer[(size_t)sequence*nextLayerErrorTermStride+neuronInNextLayer];
+                        rnnfloat_t *sequenceErrorTerms=layerErrorTerms+(size_t)sequence*errorTermStride;
+                        for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
+                            sequenceErrorTerms[neuronInThisLayer]+=weightRow[neuronInThisLayer]*errorTermOfNeuronInNextLayer;
+                    }
                 }
-                else
-                    errorTerm=(1.0-pow(outputValue,2))*sumOfErrorTermsMultipliedByWeightsInNextLayer;
-                errorTerms[thisLayer-1 /*Input layer not included*/][neuronInThisLayer]=errorTerm;
+            }
+            if(getActivationType(thisLayer)!=activationNone) // Without an activation function (the logits of a softmax), the derivative is 1.
+            {
+                for(uint32_t sequence=0;sequence<batchSize;sequence++)
+                    RNNActivation::multiplyByTanhDerivative(thisState->getNeuronValues(thisLayer,sequence),layerErrorTerms+(size_t)sequence*errorTermStride,neuronsInThisLayer);
+            }
 
-                // Update weights pointing to this neuron:
+            // Accumulate the changes of the weights pointing to the neurons in this layer, and of their bias weights. Each diff row is
+            // updated for all sequences while it is in the cache.
 
-                for(uint32_t neuronInPreviousLayer=0;neuronInPreviousLayer<neuronsInPreviousLayer;neuronInPreviousLayer++)
+            uint32_t weightLayerIndex=thisLayer-1 /*Input layer not included*/;
+            rnnfloat_t *biasDiff=weightDiff->getBiasWeights(weightLayerIndex);
+            if(thisLayer==1)
+            {
+                // The inputs are often sparse (e.g. one-hot): only the diffs of the weights of nonzero inputs change, and the others are
+                // skipped (adding zero would not change them). The previous output part is dense. The sums are the same as below.
+                for(uint32_t sequence=0;sequence<batchSize;sequence++)
                 {
-                    if(!weightsAllocated)
+                    rnnfloat_t *input=thisState->getInput(sequence);
+                    rnnfloat_t *previousOutput=thisState->getPreviousOutput(sequence);
+                    uint32_t nonZeroInputCount=0;
+                    for(uint32_t i=0;i<inputCount;i++)
                     {
-                        if(neuronInThisLayer==0) // Allocate weight diffs of neurons in previous layer upon first iteration of "neuronInThisLayer".
-                            weightDiff[thisLayer-1 /*Input layer not included*/][neuronInPreviousLayer]=(double*)malloc(neuronsInThisLayer*sizeof(double));
-                        weightDiff[thisLayer-1 /*Input layer not included*/][neuronInPreviousLayer][neuronInThisLayer]=0.0;
+                        if(input[i]!=0.0)
+                            nonZeroInputIndices[nonZeroInputCount++]=i;
                     }
-                    double valueOfNeuronInPreviousLayer=thisState->neuronValues[thisLayer-1][neuronInPreviousLayer];
-                    weightDiff[thisLayer-1 /*Input layer not included*/][neuronInPreviousLayer][neuronInThisLayer]+=errorTerm*valueOfNeuronInPreviousLayer;
+                    if(sparseUpdates)
+                    {
+                        for(uint32_t i=0;i<nonZeroInputCount;i++)
+                        {
+                            if(!isInputTouched[nonZeroInputIndices[i]])
+                            {
+                                isInputTouched[nonZeroInputIndices[i]]=true;
+                                touchedInputIndices[touchedInputCount++]=nonZeroInputIndices[i];
+                            }
+                        }
+                    }
+                    for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
+                    {
+                        rnnfloat_t errorTerm=layerErrorTerms[(size_t)sequence*errorTermStride+neuronInThisLayer];
+                        rnnfloat_t *weightDiffRow=weightDiff->getWeightRow(weightLayerIndex,neuronInThisLayer);
+                        for(uint32_t i=0;i<nonZeroInputCount;i++)
+                            weightDiffRow[nonZeroInputIndices[i]]+=errorTerm*input[nonZeroInputIndices[i]];
+                        rnnfloat_t *previousOutputWeightDiffs=weightDiffRow+inputCount;
+                        for(uint32_t i=0;i<outputCount;i++)
+                            previousOutputWeightDiffs[i]+=errorTerm*previousOutput[i];
+                        biasDiff[neuronInThisLayer]+=errorTerm;
+                    }
+                }
+                continue;
+            }
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
+            {
+                rnnfloat_t *weightDiffRow=weightDiff->getWeightRow(weightLayerIndex,neuronInThisLayer);
+                for(uint32_t sequence=0;sequence<batchSize;sequence++)
+                {
+                    rnnfloat_t errorTerm=layerErrorTerms[(size_t)sequence*errorTermStride+neuronInThisLayer];
+                    rnnfloat_t *valuesOfNeuronsInPreviousLayer=thisState->getNeuronValues(thisLayer-1,sequence);
+                    for(uint32_t neuronInPreviousLayer=0;neuronInPreviousLayer<neuronsInPreviousLayer;neuronInPreviousLayer++)
+                        weightDiffRow[neuronInPreviousLayer]+=errorTerm*valuesOfNeuronsInPreviousLayer[neuronInPreviousLayer];
+                    biasDiff[neuronInThisLayer]+=errorTerm;
                 }
-                // Update bias
-                if(!weightsAllocated)
-                    biasDiff[thisLayer-1 /*Input layer not included*/][neuronInThisLayer]=0.0;
-                biasDiff[thisLayer-1 /*Input layer not included*/][neuronInThisLayer]+=errorTerm;
             }
-            if(thisLayer<layerCount-1)
-                free(errorTerms[thisLayer /*Input layer not included; effectively thisLayer-1+1*/]);
         }
 
         // Calculate bottomDiff:
 
-        for(uint32_t previousOutputInputNeuron=0;previousOutputInputNeuron<outputCount;previousOutputInputNeuron++)
+        for(uint32_t i=0;i<batchSize*outputCount;i++)
+            bottomDiff[i]=0.0;
+        uint32_t neuronsInNextLayer=layerNeuronCounts[1];
+        uint32_t nextLayerErrorTermStride=thisState->neuronValueStrides[1];
+        for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInNextLayer;neuronInNextLayer++)
         {
-            double errorTermTimesWeightSum=0.0;
-            uint32_t neuronsInNextLayer=layerNeuronCounts[1];
-            for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInNextLayer;neuronInNextLayer++)
-                errorTermTimesWeightSum+=errorTerms[0][neuronInNextLayer]*thisState->weights[0][inputCount+previousOutputInputNeuron][neuronInNextLayer];
-
-            bottomDiff[previousOutputInputNeuron]=errorTermTimesWeightSum;
+            rnnfloat_t *previousOutputWeights=weights->getWeightRow(0,neuronInNextLayer)+inputCount;
+            for(uint32_t sequence=0;sequence<batchSize;sequence++)
+            {
+                rnnfloat_t errorTermOfNeuronInNextLayer=errorTerms[0][(size_t)sequence*nextLayerErrorTermStride+neuronInNextLayer];
+                rnnfloat_t *sequenceBottomDiff=bottomDiff+sequence*outputCount;
+                for(uint32_t previousOutputInputNeuron=0;previousOutputInputNeuron<outputCount;previousOutputInputNeuron++)
+                    sequenceBottomDiff[previousOutputInputNeuron]+=previousOutputWeights[previousOutputInputNeuron]*errorTermOfNeuronInNextLayer;
+            }
         }
+    }
+}
+
+void RNN::applyGradients(RNNWeights *weightDiff, size_t firstParameter, size_t endParameter)
+{
+    // Weights and bias weights are updated alike, so the whole block is processed in one pass (the row padding stays zero, as its diffs
+    // are zero). Disjoint parameter ranges can be updated by different threads.
+    if(previousWeightDiff==0)
+        throw; // Shares the weights of another RNN; apply the gradients there.
+    if(weights->readOnly)
+        throw; // E.g. mapped from a model file
+
+    rnnfloat_t *parameters=weights->parameters;
+    rnnfloat_t *parameterDiff=weightDiff->parameters;
+    rnnfloat_t *previousParameterDiff=previousWeightDiff->parameters;
+    for(size_t parameter=firstParameter;parameter<endParameter;parameter++)
+    {
+        // +=, not -= needed!
+        double currentWeight=parameters[parameter];
+        double thisDelta=(1.0-momentum)*learningRate*parameterDiff[parameter]+momentum*previousParameterDiff[parameter]-weightDecay*currentWeight;
+        parameters[parameter]+=thisDelta;
+        previousParameterDiff[parameter]=thisDelta;
+    }
+}
+
+// Accesses of weights that other threads update at the same time (sparse updates): relaxed atomic loads and stores, which are plain moves on
+// the supported platforms. A concurrent update of the same weight may still be lost (the read-modify-write is not atomic), as in Hogwild.
+static inline rnnfloat_t loadSharedParameter(const rnnfloat_t *parameter)
+{
+#if defined(__GNUC__)
+    rnnfloat_t value;
+    __atomic_load(parameter,&value,__ATOMIC_RELAXED);
+    return value;
+#else
+    return *(const volatile rnnfloat_t*)parameter;
+#endif
+}
+
+static inline void storeSharedParameter(rnnfloat_t *parameter,rnnfloat_t value)
+{
+#if defined(__GNUC__)
+    __atomic_store(parameter,&value,__ATOMIC_RELAXED);
+#else
+    *(volatile rnnfloat_t*)parameter=value;
+#endif
+}
 
-        free(errorTerms[0]);
-        free(errorTerms);
+// The update of applyGradients() for one parameter of shared weights; "decayFactor" applies weight decay that was skipped before.
+static inline void updateSharedParameter(rnnfloat_t *parameter,rnnfloat_t *diff,rnnfloat_t *previousDiff,double learningRate,double momentum,double weightDecay,double decayFactor)
+{
+    double currentWeight=loadSharedParameter(parameter)*decayFactor;
+    double thisDelta=(1.0-momentum)*learningRate*(*diff)+momentum*(*previousDiff)-weightDecay*currentWeight;
+    storeSharedParameter(parameter,(rnnfloat_t)(currentWeight+thisDelta));
+    *previousDiff=thisDelta;
+    *diff=0.0;
+}
 
-        if(!weightsAllocated)
-            weightsAllocated=true;
+void RNN::setSparseUpdates()
+{
+    if(inferenceOnly||previousWeightDiff==0||accumulatedWeightDiff==0)
+        throw;
+    if(sparseUpdates)
+        return;
+    sparseUpdates=true;
+    touchedInputIndices=(uint32_t*)malloc(inputCount*sizeof(uint32_t));
+    touchedInputCount=0;
+    isInputTouched=(bool*)malloc(inputCount*sizeof(bool));
+    inputLastUpdates=(uint32_t*)malloc(inputCount*sizeof(uint32_t));
+    touchedInputDecayFactors=(double*)malloc(inputCount*sizeof(double));
+    for(uint32_t i=0;i<inputCount;i++)
+    {
+        isInputTouched[i]=false;
+        inputLastUpdates[i]=0;
     }
-    free(bottomDiff);
+    sparseUpdateCount=0;
+}
 
-    // Now that we have cycled through all states, apply all changes:
+void RNN::applySparseGradients(RNNWeights *weightDiff)
+{
+    if(!sparseUpdates)
+        throw;
+    if(weights->readOnly)
+        throw; // E.g. mapped from a model file
+    sparseUpdateCount++;
+    for(uint32_t i=0;i<touchedInputCount;i++)
+    {
+        uint32_t skippedUpdateCount=sparseUpdateCount-1-inputLastUpdates[touchedInputIndices[i]];
+        touchedInputDecayFactors[i]=skippedUpdateCount>0?pow(1.0-weightDecay,(double)skippedUpdateCount):1.0;
+    }
 
-    for(uint32_t thisLayer=layerCount-1;thisLayer>0;thisLayer--) // Input layer not included.
+    // Weight layer 0: the columns of the touched inputs and of the previous outputs, row by row
+    uint32_t neuronsInLayer1=layerNeuronCounts[1];
+    for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInLayer1;neuronInNextLayer++)
     {
-        uint32_t neuronsInThisLayer=layerNeuronCounts[thisLayer];
-        uint32_t neuronsInPreviousLayer=layerNeuronCounts[thisLayer-1];
-        for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
+        rnnfloat_t *weightRow=weights->getWeightRow(0,neuronInNextLayer);
+        rnnfloat_t *diffRow=weightDiff->getWeightRow(0,neuronInNextLayer);
+        rnnfloat_t *previousDiffRow=previousWeightDiff->getWeightRow(0,neuronInNextLayer);
+        for(uint32_t i=0;i<touchedInputCount;i++)
         {
-            // +=, not -= needed!
-            for(uint32_t neuronInPreviousLayer=0;neuronInPreviousLayer<neuronsInPreviousLayer;neuronInPreviousLayer++)
-            {
-                double currentWeight=latestState->weights[thisLayer-1 /*Input layer not included*/][neuronInPreviousLayer][neuronInThisLayer];
-                double _weightDiff=weightDiff[thisLayer-1 /*Input layer not included*/][neuronInPreviousLayer][neuronInThisLayer];
-                double previousDelta=previousWeightDiff[thisLayer-1 /*Input layer not included*/][neuronInPreviousLayer][neuronInThisLayer];
-                double thisDelta=(1.0-momentum)*learningRate*_weightDiff+momentum*previousDelta-weightDecay*currentWeight;
-                latestState->weights[thisLayer-1 /*Input layer not included*/][neuronInPreviousLayer][neuronInThisLayer]+=thisDelta;
-                previousWeightDiff[thisLayer-1 /*Input layer not included*/][neuronInPreviousLayer][neuronInThisLayer]=thisDelta;
-            }
-            double previousDelta=previousBiasWeightDiff[thisLayer-1 /*Input layer not included*/][neuronInThisLayer];
-            double currentWeight=latestState->biasWeights[thisLayer-1 /*Input layer not included*/][neuronInThisLayer];
-            double _weightDiff=biasDiff[thisLayer-1 /*Input layer not included*/][neuronInThisLayer];
-            double thisDelta=(1.0-momentum)*learningRate*_weightDiff+momentum*previousDelta-weightDecay*currentWeight;
-            latestState->biasWeights[thisLayer-1 /*Input layer not included*/][neuronInThisLayer]+=thisDelta;
-            previousBiasWeightDiff[thisLayer-1 /*Input layer not included*/][neuronInThisLayer]=thisDelta;
+            uint32_t column=touchedInputIndices[i];
+            updateSharedParameter(weightRow+column,diffRow+column,previousDiffRow+column,learningRate,momentum,weightDecay,touchedInputDecayFactors[i]);
         }
-        for(uint32_t neuronInPreviousLayer=0;neuronInPreviousLayer<neuronsInPreviousLayer;neuronInPreviousLayer++)
-            free(weightDiff[thisLayer-1][neuronInPreviousLayer]);
-        free(biasDiff[thisLayer-1 /*Input layer not included*/]);
-        free(weightDiff[thisLayer-1 /*Input layer not included*/]);
+        for(uint32_t column=inputCount;column<inputAndOutputCount;column++)
+            updateSharedParameter(weightRow+column,diffRow+column,previousDiffRow+column,learningRate,momentum,weightDecay,1.0);
     }
+    for(uint32_t i=0;i<touchedInputCount;i++)
+    {
+        inputLastUpdates[touchedInputIndices[i]]=sparseUpdateCount;
+        isInputTouched[touchedInputIndices[i]]=false;
+    }
+    touchedInputCount=0;
+
+    // Bias weights of weight layer 0 and all upper layers are dense; they follow weight layer 0 in one block (the padding stays zero).
+    rnnfloat_t *parameters=weights->parameters;
+    rnnfloat_t *parameterDiff=weightDiff->parameters;
+    rnnfloat_t *previousParameterDiff=previousWeightDiff->parameters;
+    for(size_t parameter=weights->biasWeightOffsets[0];parameter<weights->parameterCount;parameter++)
+        updateSharedParameter(parameters+parameter,parameterDiff+parameter,previousParameterDiff+parameter,learningRate,momentum,weightDecay,1.0);
+}
 
-    free(biasDiff);
-    free(weightDiff);
+void RNN::applyPendingWeightDecay()
+{
+    if(!sparseUpdates)
+        throw;
+    uint32_t neuronsInLayer1=layerNeuronCounts[1];
+    for(uint32_t column=0;column<inputCount;column++)
+    {
+        uint32_t skippedUpdateCount=sparseUpdateCount-inputLastUpdates[column];
+        if(skippedUpdateCount==0)
+            continue;
+        double decayFactor=pow(1.0-weightDecay,(double)skippedUpdateCount);
+        for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInLayer1;neuronInNextLayer++)
+        {
+            rnnfloat_t *weight=weights->getWeightRow(0,neuronInNextLayer)+column;
+            storeSharedParameter(weight,(rnnfloat_t)(loadSharedParameter(weight)*decayFactor));
+        }
+        inputLastUpdates[column]=sparseUpdateCount;
+    }
 }
@@ -9,6 +9,11 @@
 #include <math.h>
 
 #include "rnnstate.h"
+#include "rnnweights.h"
+#include "rnnkernels.h"
+#include "rnnactivation.h"
+#include "rnnthreadteam.h"
+#include "rnnsession.h"
 
 
 #include <iostream>
@@ -16,12 +21,46 @@
 
 // Here, the input and output layers are meant to be included in "_layerCount" and "_layerNeuronCounts".
 
+// Layers with fewer neurons than this per thread are processed by the calling thread alone.
+#define RNN_MIN_NEURONS_PER_THREAD 64
+
+class RNN;
+
+// Arguments of RNN::layerForwardTask()
+struct RNNLayerForwardTask
+{
+    RNN *rnn;
+    RNNState *state;
+    uint32_t thisLayer;
+    uint32_t sequenceCount;
+};
+
 class RNN
 {
 public:
     uint32_t stateArrayPos;
     uint32_t stateArraySize;
-    RNNState **states; // Stores previous iterations
+    uint32_t storedStateCount; // Number of states pushed so far, up to stateArraySize
+    bool continuesSequence; // Set by pushState(): whether a step was processed before the current one (its output is the previous output)
+    RNNState **states; // Stores the activations of previous iterations
+
+    RNNWeights *weights; // Shared by all states
+    RNNWeights *previousWeightDiff; // Momentum terms; 0 if the weights are shared (unless assigned; always owned)
+    bool ownsWeights; // False if the weights belong to another RNN (see RNNTrainer)
+
+    // Scratch memory of learnBatch()/computeGradients(), allocated once by the constructor
+    RNNWeights *accumulatedWeightDiff; // Gradients (summed over all steps and sequences); 0 if the weights are shared (unless assigned; always owned)
+    rnnfloat_t **errorTerms; // Dimensions: layers (without the input layer) -> sequences -> error terms (padded like the neuron values); 0 if inference only
+    rnnfloat_t *bottomDiff; // Dimensions: sequences -> derivatives of the loss function w.r.t. the previous outputs
+    uint32_t *nonZeroInputIndices; // Dimensions: inputs (up to inputCount are used)
+    // Sparse updates only (see setSparseUpdates()); Dimensions: inputs
+    uint32_t *touchedInputIndices; // Inputs that were nonzero since the last update (up to touchedInputCount are used)
+    uint32_t touchedInputCount;
+    bool *isInputTouched;
+    uint32_t *inputLastUpdates; // Value of sparseUpdateCount at the last update of each input's column
+    double *touchedInputDecayFactors; // Scratch memory of applySparseGradients(): pending decay of each touched column
+    uint32_t sparseUpdateCount;
+    rnnfloat_t *sparseBiasWeights; // Scratch memory of processSparseBatch(); Dimensions: neurons in layer 1
 
     double learningRate;
     double momentum;
@@ -31,10 +70,22 @@ public:
     uint32_t inputAndOutputCount;
     uint32_t layerCount;
     uint32_t backpropagationSteps;
+    uint32_t batchSize; // Number of independent sequences that are processed in lockstep
     uint32_t *layerNeuronCounts;
 
-    double ***previousWeightDiff;
-    double **previousBiasWeightDiff;
+    RNNKernelType kernelType; // Defaults to the best kernel type supported by the CPU; kernelScalar can be used as a reference.
+    RNNActivationType activationType; // Defaults to activationFast; activationExact can be used as a reference.
+    // Defaults to outputTanh (squared error). outputSoftmax: the output layer is a softmax (a probability distribution) and learning minimizes
+    // the cross-entropy with the desired outputs, which should then be distributions as well (e.g. one-hot); both are fused, i.e. the error
+    // terms of the output layer are computed directly from the probabilities.
+    RNNOutputType outputType;
+    // Serving: keeps a single state record (the current one, whose output becomes the next previous output) and releases the history and all
+    // learning memory (momentum terms, gradients, error terms), so that a step is just the forward pass and the memory is the model plus one
+    // record. The current sequence continues; learning throws afterwards. Cannot be undone.
+    void setInferenceOnly();
+    bool inferenceOnly;
+    RNNThreadTeam *threadTeam; // Optional (0 by default): splits the neurons of wide layers across threads in process(). Not owned; can be shared.
+
 
 
     static double sig(double input); // sigmoid function
@@ -46,12 +97,84 @@ public:
     bool hasState(uint32_t stepsBack);
     uint32_t getAvailableStepsBack();
     RNNState *getState(uint32_t stepsBack);
+    void startNewSequence(); // Forgets the history; the next step starts with a zero previous output, like the first step of a fresh RNN.
+
+    static void layerForwardTask(void *context,uint32_t threadIndex,uint32_t threadCount); // RNNThreadTeam::Task; context: RNNLayerForwardTask
 
-    RNN(uint32_t _inputCount,uint32_t _outputCount,uint32_t _backpropagationSteps,double _learningRate,double _momentum,double _weightDecay,uint32_t _layerCount=2,uint32_t *_layerNeuronCounts=0);
+    RNN(uint32_t _inputCount,uint32_t _outputCount,uint32_t _backpropagationSteps,double _learningRate,double _momentum,double _weightDecay,uint32_t _layerCount=2,uint32_t *_layerNeuronCounts=0,uint32_t _batchSize=1,RNNWeights *_sharedWeights=0);
     ~RNN();
 
-    double *process(double *input);
-    void learn(double **desiredOutputs);
+    // process(), step() and learn() require a batch size of 1.
+    rnnfloat_t *process(rnnfloat_t *input); // The returned output must be freed.
+    void process(const rnnfloat_t *input,rnnfloat_t *output); // "output" is provided by the caller.
+    // Returns a view of the output in the current state, which stays valid until the state is reused, i.e. for backpropagationSteps more steps.
+    const rnnfloat_t *step(const rnnfloat_t *input);
+    void learn(rnnfloat_t **desiredOutputs);
+
+    // Dimensions: inputs/outputs: sequences -> values; desiredOutputs: sequences -> steps (oldest first) -> values
+    // Each sequence has its own history and previous output. The gradients of all sequences are summed up before the weights are updated once.
+    // "outputs" may be 0; the outputs are available as getCurrentState()->getOutput(sequence) as well.
+    void processBatch(const rnnfloat_t *const *inputs,rnnfloat_t **outputs);
+    void learnBatch(rnnfloat_t ***desiredOutputs);
+
+    // Sparse inputs, e.g. one-hot encoded symbols: only the listed input values are nonzero. The first layer is computed from the weights of
+    // these inputs (gathered) and the dense previous output part, instead of multiplying the whole input layer; the results match
+    // processBatch() up to floating-point rounding. The learning functions skip zero inputs anyway, so only the gradients of the used
+    // inputs' weights are accumulated. Wide first layers are not split across the thread team here.
+    // Dimensions: inputIndices/inputValues: sequences -> listed inputs (distinct indices); "inputValues" may be 0 (all 1.0).
+    void processSparseBatch(const uint32_t *const *inputIndices,const rnnfloat_t *const *inputValues,const uint32_t *inputValueCounts,rnnfloat_t **outputs);
+    void processIndexBatch(const uint32_t *inputIndices,rnnfloat_t **outputs); // One-hot; Dimensions: sequences
+    const rnnfloat_t *stepIndex(uint32_t inputIndex); // One-hot, batch size 1; see step()
+
+    // Steps "sessionCount" (up to batchSize) independent streams, one per sequence: the previous outputs are taken from the sessions and the
+    // new outputs are stored back (see RNNSession). Only the used sequences are computed. The current state record serves as scratch memory,
+    // so the RNN's own sequence does not continue; typically, an inference-only RNN per thread is used as the executor.
+    void processSessions(RNNSession *const *sessions,uint32_t sessionCount,const rnnfloat_t *const *inputs,rnnfloat_t **outputs);
+    void processSessionIndices(RNNSession *const *sessions,uint32_t sessionCount,const uint32_t *inputIndices,rnnfloat_t **outputs); // One-hot
+    const rnnfloat_t *stepSession(RNNSession *session,const rnnfloat_t *input); // The view stays valid until the next step of this RNN.
+
+    // Truncated BPTT(k1, k2) on live streams: the desired outputs are stored in the states, and every k1 ("learningInterval") steps,
+    // setDesiredOutput(s)() automatically runs a backward pass through the last k2 (backpropagationSteps+1) steps, in which only the newest k1
+    // steps contribute errors, so that every desired output is used once. k1=k2 matches calling learn() every k2 steps; smaller k1 values
+    // learn more often at the cost of more backward steps per forward step. 0 (default): only learn when learn()/learnBatch() is called.
+    uint32_t learningInterval;
+    uint32_t stepsSinceLearning;
+    void setLearningInterval(uint32_t _learningInterval); // k1<=k2 is required.
+    void setDesiredOutput(const rnnfloat_t *desiredOutput); // Desired output of the current step (batch size 1)
+    void setDesiredOutputs(const rnnfloat_t *const *desiredOutputs); // Dimensions: sequences -> values
+    void storeDesiredOutputs(rnnfloat_t ***desiredOutputs); // As passed to learnBatch(); does not learn.
+    void learnFromStoredDesiredOutputs(uint32_t errorStepCount); // Errors of the newest "errorStepCount" steps only
+
+    // Cost split: steps processed by forward passes and by backward passes (states visited); the backward/forward ratio is about k2/k1.
+    uint64_t forwardStepCount;
+    uint64_t backwardStepCount;
+
+    // learnBatch() in two phases. computeGradients() only reads the weights and adds the gradients (the same layout as the weights) to
+    // "weightDiff", so RNNs that share their weights can compute gradients in parallel. applyGradients() updates the weights and the momentum
+    // terms in [firstParameter, endParameter); it needs an RNN that owns its weights.
+    void computeGradients(RNNWeights *weightDiff,uint32_t errorStepCount); // Uses the desired outputs stored in the states (see above).
+    void applyGradients(RNNWeights *weightDiff,size_t firstParameter,size_t endParameter);
+
+    // Sparse updates of shared weights (Hogwild mode of RNNTrainer): learning applies the gradients with applySparseGradients(), which only
+    // touches the weight layer 0 columns of the inputs that were nonzero since the last update, plus the dense parts (previous output
+    // columns, bias weights and all upper layers). The skipped columns get their weight decay lazily, when they are next updated or by
+    // applyPendingWeightDecay(); their momentum only carries over between updates that touch them. The weights are read and written with
+    // relaxed atomic accesses. Needs own momentum terms and gradient buffer (previousWeightDiff, accumulatedWeightDiff). Cannot be undone.
+    void setSparseUpdates();
+    bool sparseUpdates;
+    void applySparseGradients(RNNWeights *weightDiff); // Zeroes the used gradients, so that "weightDiff" is all zeroes afterwards.
+    void applyPendingWeightDecay(); // Brings the decay of all skipped columns up to date.
+
+    // Parts of a forward step
+    // "previousSequences" (Dimensions: sequences) lets sequences continue the previous output of another sequence, e.g. to fork hypotheses
+    // (see RNNBeamSearch); 0: every sequence continues its own.
+    void copyPreviousOutputs(RNNState *newState,const uint32_t *previousSequences=0);
+    void sparseFirstLayerForward(RNNState *state,uint32_t sequence,const uint32_t *inputIndices,const rnnfloat_t *inputValues,uint32_t inputValueCount);
+    void forwardPass(RNNState *state,uint32_t firstLayer,uint32_t sequenceCount); // Computes the layers after "firstLayer" from it, for the first "sequenceCount" sequences
+    void copyOutputs(RNNState *state,rnnfloat_t **outputs); // "outputs" may be 0.
+    RNNState *beginSessionStep(RNNSession *const *sessions,uint32_t sessionCount); // Pushes a state with the sessions' previous outputs.
+    void endSessionStep(RNNState *state,RNNSession *const *sessions,uint32_t sessionCount,rnnfloat_t **outputs);
+    RNNActivationType getActivationType(uint32_t thisLayer); // Of the neurons in "thisLayer"
 };
 
 #endif // RNN_H
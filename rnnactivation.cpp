@@ -0,0 +1,532 @@
+#include "rnnactivation.h"
+
+#include <string.h>
+
+#ifdef RNNKERNELS_X86
+#include <immintrin.h>
+#endif
+
+// tanh(x)=1-2/(exp(2x)+1) for x>=0; the sign is restored afterwards. Beyond 20, tanh(x) rounds to 1.0 in double precision.
+#define ACTIVATION_FAST_MAX_INPUT 20.0
+// exp(y)=2^k*exp(r) with k=round(y/ln(2)) and r=y-k*ln(2) in [-ln(2)/2, ln(2)/2]; ln(2) is split in two parts so that r is exact.
+#define ACTIVATION_LOG2E 1.4426950408889634074
+#define ACTIVATION_LN2_HI 6.93147180369123816490e-01
+#define ACTIVATION_LN2_LO 1.90821492927058770002e-10
+// Single precision: beyond 9, tanh(x) rounds to 1.0f. ln(2) is split so that k*ACTIVATION_LN2_HI_FLOAT is exact for k<=2^15.
+#define ACTIVATION_FAST_MAX_INPUT_FLOAT 9.0f
+#define ACTIVATION_LN2_HI_FLOAT 0.693359375f
+#define ACTIVATION_LN2_LO_FLOAT -2.12194440e-4f
+// exp() of a softmax: the inputs are <=0 after subtracting the maximum; below these, exp() is clamped (the results would be denormal or 0).
+#define ACTIVATION_EXP_MIN_INPUT -708.0
+#define ACTIVATION_EXP_MIN_INPUT_FLOAT -86.0f
+// The rational approximation overshoots 1.0 at about 4.97; clamping the input at 4.79 minimizes the max. error over the whole range.
+#define ACTIVATION_RATIONAL_MAX_INPUT 4.79
+
+const char *RNNActivation::getActivationTypeName(RNNActivationType activationType)
+{
+    switch(activationType)
+    {
+    case activationFast:
+        return "fast";
+    case activationRational:
+        return "rational";
+    case activationNone:
+        return "none";
+    default:
+        return "exact";
+    }
+}
+
+void RNNActivation::tanhArray(RNNActivationType activationType, RNNKernelType kernelType, double *values, uint32_t count)
+{
+    if(activationType==activationNone)
+        return;
+    if(activationType==activationExact)
+    {
+        for(uint32_t i=0;i<count;i++)
+            values[i]=::tanh(values[i]);
+        return;
+    }
+#ifdef RNNKERNELS_X86
+    if(kernelType!=kernelScalar)
+    {
+        if(activationType==activationFast)
+            tanhArrayFastAVX2(values,count);
+        else
+            tanhArrayRationalAVX2(values,count);
+        return;
+    }
+#endif
+    if(activationType==activationFast)
+        tanhArrayFastScalar(values,count);
+    else
+        tanhArrayRationalScalar(values,count);
+}
+
+void RNNActivation::sigArray(RNNActivationType activationType, RNNKernelType kernelType, double *values, uint32_t count)
+{
+    // sig(x)=0.5*(1+tanh(x/2))
+    for(uint32_t i=0;i<count;i++)
+        values[i]*=0.5;
+    tanhArray(activationType,kernelType,values,count);
+    for(uint32_t i=0;i<count;i++)
+        values[i]=0.5+0.5*values[i];
+}
+
+void RNNActivation::multiplyByTanhDerivative(const double *outputs, double *values, uint32_t count)
+{
+    for(uint32_t i=0;i<count;i++)
+        values[i]*=(1.0-outputs[i]*outputs[i]);
+}
+
+void RNNActivation::tanhArray(RNNActivationType activationType, RNNKernelType kernelType, float *values, uint32_t count)
+{
+    if(activationType==activationNone)
+        return;
+    if(activationType==activationExact)
+    {
+        for(uint32_t i=0;i<count;i++)
+            values[i]=::tanhf(values[i]);
+        return;
+    }
+#ifdef RNNKERNELS_X86
+    if(kernelType!=kernelScalar)
+    {
+        if(activationType==activationFast)
+            tanhArrayFastAVX2(values,count);
+        else
+            tanhArrayRationalAVX2(values,count);
+        return;
+    }
+#endif
+    if(activationType==activationFast)
+        tanhArrayFastScalar(values,count);
+    else
+        tanhArrayRationalScalar(values,count);
+}
+
+void RNNActivation::sigArray(RNNActivationType activationType, RNNKernelType kernelType, float *values, uint32_t count)
+{
+    for(uint32_t i=0;i<count;i++)
+        values[i]*=0.5f;
+    tanhArray(activationType,kernelType,values,count);
+    for(uint32_t i=0;i<count;i++)
+        values[i]=0.5f+0.5f*values[i];
+}
+
+void RNNActivation::multiplyByTanhDerivative(const float *outputs, float *values, uint32_t count)
+{
+    for(uint32_t i=0;i<count;i++)
+        values[i]*=(1.0f-outputs[i]*outputs[i]);
+}
+
+void RNNActivation::softmaxArray(RNNActivationType activationType, RNNKernelType kernelType, double *values, uint32_t count)
+{
+    if(count==0)
+        return;
+    double maxValue=values[0];
+    for(uint32_t i=1;i<count;i++)
+        maxValue=fmax(maxValue,values[i]);
+    double sum;
+    if(activationType==activationExact||activationType==activationNone)
+    {
+        sum=0.0;
+        for(uint32_t i=0;i<count;i++)
+        {
+            values[i]=::exp(values[i]-maxValue);
+            sum+=values[i];
+        }
+    }
+#ifdef RNNKERNELS_X86
+    else if(kernelType!=kernelScalar)
+        sum=expArrayFastAVX2(values,maxValue,count);
+#endif
+    else
+        sum=expArrayFastScalar(values,maxValue,count);
+    double inverseSum=1.0/sum; // sum>=1, as the maximum contributes exp(0)
+    for(uint32_t i=0;i<count;i++)
+        values[i]*=inverseSum;
+}
+
+void RNNActivation::softmaxErrorTerms(const double *outputs, const double *desiredOutputs, const double *outputDiffs, double *errorTerms, uint32_t count)
+{
+    // With p=outputs, d=desiredOutputs, g=outputDiffs: the cross-entropy loss -sum(d*log(p)) contributes d-p*sum(d), and the softmax
+    // Jacobian turns g into p*(g-sum(p*g)).
+    double desiredOutputSum=0.0;
+    double weightedOutputDiffSum=0.0;
+    for(uint32_t i=0;i<count;i++)
+    {
+        if(desiredOutputs!=0)
+            desiredOutputSum+=desiredOutputs[i];
+        if(outputDiffs!=0)
+            weightedOutputDiffSum+=outputs[i]*outputDiffs[i];
+    }
+    double shift=desiredOutputSum+weightedOutputDiffSum;
+    for(uint32_t i=0;i<count;i++)
+        errorTerms[i]=(desiredOutputs!=0?desiredOutputs[i]:0.0)+outputs[i]*((outputDiffs!=0?outputDiffs[i]:0.0)-shift);
+}
+
+void RNNActivation::softmaxArray(RNNActivationType activationType, RNNKernelType kernelType, float *values, uint32_t count)
+{
+    if(count==0)
+        return;
+    float maxValue=values[0];
+    for(uint32_t i=1;i<count;i++)
+        maxValue=fmaxf(maxValue,values[i]);
+    float sum;
+    if(activationType==activationExact||activationType==activationNone)
+    {
+        sum=0.0f;
+        for(uint32_t i=0;i<count;i++)
+        {
+            values[i]=::expf(values[i]-maxValue);
+            sum+=values[i];
+        }
+    }
+#ifdef RNNKERNELS_X86
+    else if(kernelType!=kernelScalar)
+        sum=expArrayFastAVX2(values,maxValue,count);
+#endif
+    else
+        sum=expArrayFastScalar(values,maxValue,count);
+    float inverseSum=1.0f/sum; // sum>=1, as the maximum contributes exp(0)
+    for(uint32_t i=0;i<count;i++)
+        values[i]*=inverseSum;
+}
+
+void RNNActivation::softmaxErrorTerms(const float *outputs, const float *desiredOutputs, const float *outputDiffs, float *errorTerms, uint32_t count)
+{
+    // With p=outputs, d=desiredOutputs, g=outputDiffs: the cross-entropy loss -sum(d*log(p)) contributes d-p*sum(d), and the softmax
+    // Jacobian turns g into p*(g-sum(p*g)).
+    float desiredOutputSum=0.0f;
+    float weightedOutputDiffSum=0.0f;
+    for(uint32_t i=0;i<count;i++)
+    {
+        if(desiredOutputs!=0)
+            desiredOutputSum+=desiredOutputs[i];
+        if(outputDiffs!=0)
+            weightedOutputDiffSum+=outputs[i]*outputDiffs[i];
+    }
+    float shift=desiredOutputSum+weightedOutputDiffSum;
+    for(uint32_t i=0;i<count;i++)
+        errorTerms[i]=(desiredOutputs!=0?desiredOutputs[i]:0.0f)+outputs[i]*((outputDiffs!=0?outputDiffs[i]:0.0f)-shift);
+}
+
+double RNNActivation::expArrayFastScalar(double *values, double shift, uint32_t count)
+{
+    // Same method as tanhArrayFastScalar(); k is negative here.
+    double sum=0.0;
+    for(uint32_t i=0;i<count;i++)
+    {
+        double y=fmax(values[i]-shift,ACTIVATION_EXP_MIN_INPUT);
+        double k=floor(y*ACTIVATION_LOG2E+0.5);
+        double r=(y-k*ACTIVATION_LN2_HI)-k*ACTIVATION_LN2_LO;
+        double p=1.0/362880.0;
+        p=p*r+1.0/40320.0;
+        p=p*r+1.0/5040.0;
+        p=p*r+1.0/720.0;
+        p=p*r+1.0/120.0;
+        p=p*r+1.0/24.0;
+        p=p*r+1.0/6.0;
+        p=p*r+0.5;
+        p=p*r+1.0;
+        p=p*r+1.0;
+        // -1022<k<=0: the result is a normal number.
+        uint64_t bits;
+        memcpy(&bits,&p,sizeof(double));
+        bits+=((uint64_t)(int64_t)k)<<52;
+        memcpy(&values[i],&bits,sizeof(double));
+        sum+=values[i];
+    }
+    return sum;
+}
+
+float RNNActivation::expArrayFastScalar(float *values, float shift, uint32_t count)
+{
+    float sum=0.0f;
+    for(uint32_t i=0;i<count;i++)
+    {
+        float y=fmaxf(values[i]-shift,ACTIVATION_EXP_MIN_INPUT_FLOAT);
+        float k=floorf(y*(float)ACTIVATION_LOG2E+0.5f);
+        float r=(y-k*ACTIVATION_LN2_HI_FLOAT)-k*ACTIVATION_LN2_LO_FLOAT;
+        float p=1.0f/720.0f;
+        p=p*r+1.0f/120.0f;
+        p=p*r+1.0f/24.0f;
+        p=p*r+1.0f/6.0f;
+        p=p*r+0.5f;
+        p=p*r+1.0f;
+        p=p*r+1.0f;
+        // -126<k<=0
+        uint32_t bits;
+        memcpy(&bits,&p,sizeof(float));
+        bits+=((uint32_t)(int32_t)k)<<23;
+        memcpy(&values[i],&bits,sizeof(float));
+        sum+=values[i];
+    }
+    return sum;
+}
+
+void RNNActivation::tanhArrayFastScalar(double *values, uint32_t count)
+{
+    for(uint32_t i=0;i<count;i++)
+    {
+        double x=values[i];
+        double y=2.0*fmin(fabs(x),ACTIVATION_FAST_MAX_INPUT);
+        double k=floor(y*ACTIVATION_LOG2E+0.5);
+        double r=(y-k*ACTIVATION_LN2_HI)-k*ACTIVATION_LN2_LO;
+        double p=1.0/362880.0;
+        p=p*r+1.0/40320.0;
+        p=p*r+1.0/5040.0;
+        p=p*r+1.0/720.0;
+        p=p*r+1.0/120.0;
+        p=p*r+1.0/24.0;
+        p=p*r+1.0/6.0;
+        p=p*r+0.5;
+        p=p*r+1.0;
+        p=p*r+1.0;
+        // Multiply by 2^k by adding k to the exponent (0<=k<=58, so this cannot overflow):
+        uint64_t bits;
+        memcpy(&bits,&p,sizeof(double));
+        bits+=((uint64_t)k)<<52;
+        double e;
+        memcpy(&e,&bits,sizeof(double));
+        values[i]=copysign(1.0-2.0/(e+1.0),x);
+    }
+}
+
+void RNNActivation::tanhArrayRationalScalar(double *values, uint32_t count)
+{
+    for(uint32_t i=0;i<count;i++)
+    {
+        double x=fmax(-ACTIVATION_RATIONAL_MAX_INPUT,fmin(ACTIVATION_RATIONAL_MAX_INPUT,values[i]));
+        double x2=x*x;
+        double numerator=x*(135135.0+x2*(17325.0+x2*(378.0+x2)));
+        double denominator=135135.0+x2*(62370.0+x2*(3150.0+x2*28.0));
+        values[i]=fmax(-1.0,fmin(1.0,numerator/denominator));
+    }
+}
+
+void RNNActivation::tanhArrayFastScalar(float *values, uint32_t count)
+{
+    // Same method as the double precision version, with a degree 6 polynomial.
+    for(uint32_t i=0;i<count;i++)
+    {
+        float x=values[i];
+        float y=2.0f*fminf(fabsf(x),ACTIVATION_FAST_MAX_INPUT_FLOAT);
+        float k=floorf(y*(float)ACTIVATION_LOG2E+0.5f);
+        float r=(y-k*ACTIVATION_LN2_HI_FLOAT)-k*ACTIVATION_LN2_LO_FLOAT;
+        float p=1.0f/720.0f;
+        p=p*r+1.0f/120.0f;
+        p=p*r+1.0f/24.0f;
+        p=p*r+1.0f/6.0f;
+        p=p*r+0.5f;
+        p=p*r+1.0f;
+        p=p*r+1.0f;
+        // 0<=k<=26
+        uint32_t bits;
+        memcpy(&bits,&p,sizeof(float));
+        bits+=((uint32_t)k)<<23;
+        float e;
+        memcpy(&e,&bits,sizeof(float));
+        values[i]=copysignf(1.0f-2.0f/(e+1.0f),x);
+    }
+}
+
+void RNNActivation::tanhArrayRationalScalar(float *values, uint32_t count)
+{
+    const float maxInput=(float)ACTIVATION_RATIONAL_MAX_INPUT;
+    for(uint32_t i=0;i<count;i++)
+    {
+        float x=fmaxf(-maxInput,fminf(maxInput,values[i]));
+        float x2=x*x;
+        float numerator=x*(135135.0f+x2*(17325.0f+x2*(378.0f+x2)));
+        float denominator=135135.0f+x2*(62370.0f+x2*(3150.0f+x2*28.0f));
+        values[i]=fmaxf(-1.0f,fminf(1.0f,numerator/denominator));
+    }
+}
+
+#ifdef RNNKERNELS_X86
+
+RNNKERNELS_TARGET_AVX2 void RNNActivation::tanhArrayFastAVX2(double *values, uint32_t count)
+{
+    const __m256d signMask=_mm256_set1_pd(-0.0);
+    const __m256d maxInput=_mm256_set1_pd(ACTIVATION_FAST_MAX_INPUT);
+    const __m256d roundingConstant=_mm256_set1_pd(6755399441055744.0); // 1.5*2^52: adding it rounds to an integer that ends up in the low mantissa bits.
+    const __m256d one=_mm256_set1_pd(1.0);
+    const __m256d two=_mm256_set1_pd(2.0);
+    uint32_t i=0;
+    for(;i+4<=count;i+=4)
+    {
+        __m256d x=_mm256_loadu_pd(values+i);
+        __m256d sign=_mm256_and_pd(x,signMask);
+        __m256d y=_mm256_mul_pd(two,_mm256_min_pd(_mm256_andnot_pd(signMask,x),maxInput));
+        __m256d kShifted=_mm256_add_pd(_mm256_mul_pd(y,_mm256_set1_pd(ACTIVATION_LOG2E)),roundingConstant);
+        __m256d k=_mm256_sub_pd(kShifted,roundingConstant);
+        __m256d r=_mm256_fnmadd_pd(k,_mm256_set1_pd(ACTIVATION_LN2_HI),y);
+        r=_mm256_fnmadd_pd(k,_mm256_set1_pd(ACTIVATION_LN2_LO),r);
+        __m256d p=_mm256_set1_pd(1.0/362880.0);
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/40320.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/5040.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/720.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/120.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/24.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/6.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(0.5));
+        p=_mm256_fmadd_pd(p,r,one);
+        p=_mm256_fmadd_pd(p,r,one);
+        __m256i exponent=_mm256_slli_epi64(_mm256_castpd_si256(kShifted),52);
+        __m256d e=_mm256_castsi256_pd(_mm256_add_epi64(_mm256_castpd_si256(p),exponent));
+        __m256d result=_mm256_sub_pd(one,_mm256_div_pd(two,_mm256_add_pd(e,one)));
+        _mm256_storeu_pd(values+i,_mm256_or_pd(result,sign));
+    }
+    tanhArrayFastScalar(values+i,count-i);
+}
+
+RNNKERNELS_TARGET_AVX2 void RNNActivation::tanhArrayRationalAVX2(double *values, uint32_t count)
+{
+    const __m256d maxInput=_mm256_set1_pd(ACTIVATION_RATIONAL_MAX_INPUT);
+    const __m256d minInput=_mm256_set1_pd(-ACTIVATION_RATIONAL_MAX_INPUT);
+    const __m256d one=_mm256_set1_pd(1.0);
+    const __m256d minusOne=_mm256_set1_pd(-1.0);
+    uint32_t i=0;
+    for(;i+4<=count;i+=4)
+    {
+        __m256d x=_mm256_max_pd(minInput,_mm256_min_pd(maxInput,_mm256_loadu_pd(values+i)));
+        __m256d x2=_mm256_mul_pd(x,x);
+        __m256d numerator=_mm256_add_pd(x2,_mm256_set1_pd(378.0));
+        numerator=_mm256_fmadd_pd(numerator,x2,_mm256_set1_pd(17325.0));
+        numerator=_mm256_fmadd_pd(numerator,x2,_mm256_set1_pd(135135.0));
+        numerator=_mm256_mul_pd(numerator,x);
+        __m256d denominator=_mm256_fmadd_pd(x2,_mm256_set1_pd(28.0),_mm256_set1_pd(3150.0));
+        denominator=_mm256_fmadd_pd(denominator,x2,_mm256_set1_pd(62370.0));
+        denominator=_mm256_fmadd_pd(denominator,x2,_mm256_set1_pd(135135.0));
+        __m256d result=_mm256_div_pd(numerator,denominator);
+        _mm256_storeu_pd(values+i,_mm256_max_pd(minusOne,_mm256_min_pd(one,result)));
+    }
+    tanhArrayRationalScalar(values+i,count-i);
+}
+
+RNNKERNELS_TARGET_AVX2 void RNNActivation::tanhArrayFastAVX2(float *values, uint32_t count)
+{
+    const __m256 signMask=_mm256_set1_ps(-0.0f);
+    const __m256 maxInput=_mm256_set1_ps(ACTIVATION_FAST_MAX_INPUT_FLOAT);
+    const __m256 roundingConstant=_mm256_set1_ps(12582912.0f); // 1.5*2^23
+    const __m256 one=_mm256_set1_ps(1.0f);
+    const __m256 two=_mm256_set1_ps(2.0f);
+    uint32_t i=0;
+    for(;i+8<=count;i+=8)
+    {
+        __m256 x=_mm256_loadu_ps(values+i);
+        __m256 sign=_mm256_and_ps(x,signMask);
+        __m256 y=_mm256_mul_ps(two,_mm256_min_ps(_mm256_andnot_ps(signMask,x),maxInput));
+        __m256 kShifted=_mm256_add_ps(_mm256_mul_ps(y,_mm256_set1_ps((float)ACTIVATION_LOG2E)),roundingConstant);
+        __m256 k=_mm256_sub_ps(kShifted,roundingConstant);
+        __m256 r=_mm256_fnmadd_ps(k,_mm256_set1_ps(ACTIVATION_LN2_HI_FLOAT),y);
+        r=_mm256_fnmadd_ps(k,_mm256_set1_ps(ACTIVATION_LN2_LO_FLOAT),r);
+        __m256 p=_mm256_set1_ps(1.0f/720.0f);
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.0f/120.0f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.0f/24.0f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.0f/6.0f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(0.5f));
+        p=_mm256_fmadd_ps(p,r,one);
+        p=_mm256_fmadd_ps(p,r,one);
+        __m256i exponent=_mm256_slli_epi32(_mm256_castps_si256(kShifted),23);
+        __m256 e=_mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(p),exponent));
+        __m256 result=_mm256_sub_ps(one,_mm256_div_ps(two,_mm256_add_ps(e,one)));
+        _mm256_storeu_ps(values+i,_mm256_or_ps(result,sign));
+    }
+    tanhArrayFastScalar(values+i,count-i);
+}
+
+RNNKERNELS_TARGET_AVX2 void RNNActivation::tanhArrayRationalAVX2(float *values, uint32_t count)
+{
+    const __m256 maxInput=_mm256_set1_ps((float)ACTIVATION_RATIONAL_MAX_INPUT);
+    const __m256 minInput=_mm256_set1_ps(-(float)ACTIVATION_RATIONAL_MAX_INPUT);
+    const __m256 one=_mm256_set1_ps(1.0f);
+    const __m256 minusOne=_mm256_set1_ps(-1.0f);
+    uint32_t i=0;
+    for(;i+8<=count;i+=8)
+    {
+        __m256 x=_mm256_max_ps(minInput,_mm256_min_ps(maxInput,_mm256_loadu_ps(values+i)));
+        __m256 x2=_mm256_mul_ps(x,x);
+        __m256 numerator=_mm256_add_ps(x2,_mm256_set1_ps(378.0f));
+        numerator=_mm256_fmadd_ps(numerator,x2,_mm256_set1_ps(17325.0f));
+        numerator=_mm256_fmadd_ps(numerator,x2,_mm256_set1_ps(135135.0f));
+        numerator=_mm256_mul_ps(numerator,x);
+        __m256 denominator=_mm256_fmadd_ps(x2,_mm256_set1_ps(28.0f),_mm256_set1_ps(3150.0f));
+        denominator=_mm256_fmadd_ps(denominator,x2,_mm256_set1_ps(62370.0f));
+        denominator=_mm256_fmadd_ps(denominator,x2,_mm256_set1_ps(135135.0f));
+        __m256 result=_mm256_div_ps(numerator,denominator);
+        _mm256_storeu_ps(values+i,_mm256_max_ps(minusOne,_mm256_min_ps(one,result)));
+    }
+    tanhArrayRationalScalar(values+i,count-i);
+}
+
+RNNKERNELS_TARGET_AVX2 double RNNActivation::expArrayFastAVX2(double *values, double shift, uint32_t count)
+{
+    const __m256d shiftValue=_mm256_set1_pd(shift);
+    const __m256d minInput=_mm256_set1_pd(ACTIVATION_EXP_MIN_INPUT);
+    const __m256d roundingConstant=_mm256_set1_pd(6755399441055744.0); // 1.5*2^52; also works for negative k (two's complement)
+    const __m256d one=_mm256_set1_pd(1.0);
+    __m256d sum=_mm256_setzero_pd();
+    uint32_t i=0;
+    for(;i+4<=count;i+=4)
+    {
+        __m256d y=_mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(values+i),shiftValue),minInput);
+        __m256d kShifted=_mm256_add_pd(_mm256_mul_pd(y,_mm256_set1_pd(ACTIVATION_LOG2E)),roundingConstant);
+        __m256d k=_mm256_sub_pd(kShifted,roundingConstant);
+        __m256d r=_mm256_fnmadd_pd(k,_mm256_set1_pd(ACTIVATION_LN2_HI),y);
+        r=_mm256_fnmadd_pd(k,_mm256_set1_pd(ACTIVATION_LN2_LO),r);
+        __m256d p=_mm256_set1_pd(1.0/362880.0);
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/40320.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/5040.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/720.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/120.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/24.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(1.0/6.0));
+        p=_mm256_fmadd_pd(p,r,_mm256_set1_pd(0.5));
+        p=_mm256_fmadd_pd(p,r,one);
+        p=_mm256_fmadd_pd(p,r,one);
+        __m256i exponent=_mm256_slli_epi64(_mm256_castpd_si256(kShifted),52);
+        __m256d e=_mm256_castsi256_pd(_mm256_add_epi64(_mm256_castpd_si256(p),exponent));
+        _mm256_storeu_pd(values+i,e);
+        sum=_mm256_add_pd(sum,e);
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes,sum);
+    return (lanes[0]+lanes[1])+(lanes[2]+lanes[3])+expArrayFastScalar(values+i,shift,count-i);
+}
+
+RNNKERNELS_TARGET_AVX2 float RNNActivation::expArrayFastAVX2(float *values, float shift, uint32_t count)
+{
+    const __m256 shiftValue=_mm256_set1_ps(shift);
+    const __m256 minInput=_mm256_set1_ps(ACTIVATION_EXP_MIN_INPUT_FLOAT);
+    const __m256 roundingConstant=_mm256_set1_ps(12582912.0f); // 1.5*2^23
+    const __m256 one=_mm256_set1_ps(1.0f);
+    __m256 sum=_mm256_setzero_ps();
+    uint32_t i=0;
+    for(;i+8<=count;i+=8)
+    {
+        __m256 y=_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(values+i),shiftValue),minInput);
+        __m256 kShifted=_mm256_add_ps(_mm256_mul_ps(y,_mm256_set1_ps((float)ACTIVATION_LOG2E)),roundingConstant);
+        __m256 k=_mm256_sub_ps(kShifted,roundingConstant);
+        __m256 r=_mm256_fnmadd_ps(k,_mm256_set1_ps(ACTIVATION_LN2_HI_FLOAT),y);
+        r=_mm256_fnmadd_ps(k,_mm256_set1_ps(ACTIVATION_LN2_LO_FLOAT),r);
+        __m256 p=_mm256_set1_ps(1.0f/720.0f);
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.0f/120.0f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.0f/24.0f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(1.0f/6.0f));
+        p=_mm256_fmadd_ps(p,r,_mm256_set1_ps(0.5f));
+        p=_mm256_fmadd_ps(p,r,one);
+        p=_mm256_fmadd_ps(p,r,one);
+        __m256i exponent=_mm256_slli_epi32(_mm256_castps_si256(kShifted),23);
+        __m256 e=_mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(p),exponent));
+        _mm256_storeu_ps(values+i,e);
+        sum=_mm256_add_ps(sum,e);
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes,sum);
+    return ((lanes[0]+lanes[1])+(lanes[2]+lanes[3]))+((lanes[4]+lanes[5])+(lanes[6]+lanes[7]))+expArrayFastScalar(values+i,shift,count-i);
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef RNNACTIVATION_H
+#define RNNACTIVATION_H
+
+#include <stdint.h>
+#include <math.h>
+
+#include "rnnkernels.h" // RNNKernelType, RNNActivationType
+
+// Activation functions operating on whole neuron arrays (in place). The approximations have a scalar implementation and an AVX2 implementation,
+// which is used if "kernelType" is kernelAVX2 or kernelAVX512. activationNone leaves the values unchanged.
+
+class RNNActivation
+{
+public:
+    static const char *getActivationTypeName(RNNActivationType activationType);
+
+    static void tanhArray(RNNActivationType activationType,RNNKernelType kernelType,double *values,uint32_t count);
+    static void sigArray(RNNActivationType activationType,RNNKernelType kernelType,double *values,uint32_t count);
+
+    // values[i]*=(1.0-pow(outputs[i],2)); "outputs" are tanh() results. This is the same for all activation types.
+    static void multiplyByTanhDerivative(const double *outputs,double *values,uint32_t count);
+
+    // Softmax: values[i]=exp(values[i]-max)/sum(exp(values[j]-max)), with max, exp/sum and normalization in three passes over the (usually
+    // cached) array. exp() is approximated like in tanhArray() for activationFast and activationRational (which has no exp() of its own),
+    // and taken from libm for activationExact and activationNone.
+    static void softmaxArray(RNNActivationType activationType,RNNKernelType kernelType,double *values,uint32_t count);
+    // Error terms (negative derivatives of the loss function w.r.t. the inputs of the softmax) of a softmax output with cross-entropy loss,
+    // in one pass after one reduction: errorTerms[i]=desiredOutputs[i]-outputs[i]*sum(desiredOutputs)+outputs[i]*(outputDiffs[i]-sum(outputs*outputDiffs)),
+    // where "outputDiffs" are the negative derivatives of the loss w.r.t. the outputs from elsewhere (e.g. later steps). Either of them may
+    // be 0 (no error).
+    static void softmaxErrorTerms(const double *outputs,const double *desiredOutputs,const double *outputDiffs,double *errorTerms,uint32_t count);
+
+    // Single precision versions; the approximations are accurate to about float rounding (activationFast) or have the same error as above.
+    static void tanhArray(RNNActivationType activationType,RNNKernelType kernelType,float *values,uint32_t count);
+    static void sigArray(RNNActivationType activationType,RNNKernelType kernelType,float *values,uint32_t count);
+    static void multiplyByTanhDerivative(const float *outputs,float *values,uint32_t count);
+    static void softmaxArray(RNNActivationType activationType,RNNKernelType kernelType,float *values,uint32_t count);
+    static void softmaxErrorTerms(const float *outputs,const float *desiredOutputs,const float *outputDiffs,float *errorTerms,uint32_t count);
+
+private:
+    static void tanhArrayFastScalar(double *values,uint32_t count);
+    static void tanhArrayRationalScalar(double *values,uint32_t count);
+    static void tanhArrayFastScalar(float *values,uint32_t count);
+    static void tanhArrayRationalScalar(float *values,uint32_t count);
+    // values[i]=exp(values[i]-shift); returns the sum of the results. Inputs must be <=shift.
+    static double expArrayFastScalar(double *values,double shift,uint32_t count);
+    static float expArrayFastScalar(float *values,float shift,uint32_t count);
+#ifdef RNNKERNELS_X86
+    static void tanhArrayFastAVX2(double *values,uint32_t count);
+    static void tanhArrayRationalAVX2(double *values,uint32_t count);
+    static void tanhArrayFastAVX2(float *values,uint32_t count);
+    static void tanhArrayRationalAVX2(float *values,uint32_t count);
+    static double expArrayFastAVX2(double *values,double shift,uint32_t count);
+    static float expArrayFastAVX2(float *values,float shift,uint32_t count);
+#endif
+};
+
+#endif // RNNACTIVATION_H
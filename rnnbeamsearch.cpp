@@ -0,0 +1,155 @@
+#include "rnnbeamsearch.h"
+
+#include <algorithm>
+
+// Orders indices by their values, descending
+template<typename T> struct RNNBeamSearchOrder
+{
+    const T *values;
+
+    bool operator()(uint32_t a,uint32_t b) const
+    {
+        return values[a]>values[b];
+    }
+};
+
+RNNBeamSearch::RNNBeamSearch(RNN *model, uint32_t _beamWidth)
+{
+    beamWidth=_beamWidth;
+    symbolCount=model->inputCount<model->outputCount?model->inputCount:model->outputCount;
+    if(beamWidth==0||symbolCount==0)
+        throw;
+    rnn=new RNN(model->inputCount,model->outputCount,0 /*No history*/,0.0,0.0,0.0,model->layerCount,model->layerNeuronCounts,beamWidth,model->weights);
+    rnn->kernelType=model->kernelType;
+    rnn->activationType=model->activationType;
+    rnn->outputType=model->outputType;
+    rnn->threadTeam=model->threadTeam;
+    rnn->setInferenceOnly();
+
+    beamScores=(double*)malloc(beamWidth*sizeof(double));
+    beamSymbols=(uint32_t*)malloc(beamWidth*sizeof(uint32_t));
+    beamParents=(uint32_t*)malloc(beamWidth*sizeof(uint32_t));
+    candidateScores=(double*)malloc((size_t)beamWidth*symbolCount*sizeof(double));
+    candidates=(uint32_t*)malloc((size_t)beamWidth*symbolCount*sizeof(uint32_t));
+}
+
+RNNBeamSearch::~RNNBeamSearch()
+{
+    delete rnn;
+    free(beamScores);
+    free(beamSymbols);
+    free(beamParents);
+    free(candidateScores);
+    free(candidates);
+}
+
+double RNNBeamSearch::decode(const uint32_t *prompt, uint32_t promptLength, uint32_t *symbols, uint32_t length)
+{
+    if(promptLength==0)
+        throw;
+    // The prompt is processed by all beams alike; afterwards, there is a single hypothesis.
+    rnn->startNewSequence();
+    for(uint32_t i=0;i<promptLength;i++)
+    {
+        for(uint32_t beam=0;beam<beamWidth;beam++)
+            beamSymbols[beam]=prompt[i];
+        step(beamSymbols,0);
+    }
+    uint32_t activeBeamCount=1;
+    beamScores[0]=0.0;
+
+    // Dimensions: steps -> beams; to trace the best hypothesis back at the end
+    uint32_t *symbolHistory=(uint32_t*)malloc((size_t)length*beamWidth*sizeof(uint32_t));
+    uint32_t *parentHistory=(uint32_t*)malloc((size_t)length*beamWidth*sizeof(uint32_t));
+    RNNBeamSearchOrder<double> candidateOrder;
+    candidateOrder.values=candidateScores;
+    for(uint32_t t=0;t<length;t++)
+    {
+        // Every hypothesis contributes at most beamWidth extensions, its most probable ones; others could not be among the best.
+        uint32_t candidateCount=0;
+        RNNState *state=rnn->getCurrentState();
+        for(uint32_t beam=0;beam<activeBeamCount;beam++)
+            addCandidateScores(beam,state->getOutput(beam),candidateCount);
+        uint32_t newBeamCount=candidateCount<beamWidth?candidateCount:beamWidth;
+        std::partial_sort(candidates,candidates+newBeamCount,candidates+candidateCount,candidateOrder);
+        for(uint32_t beam=0;beam<beamWidth;beam++)
+        {
+            // Unused beams are computed as well (the batch size is fixed); they repeat beam 0.
+            uint32_t candidate=candidates[beam<newBeamCount?beam:0];
+            beamParents[beam]=candidate/symbolCount;
+            beamSymbols[beam]=candidate%symbolCount;
+            beamScores[beam]=candidateScores[candidate];
+            symbolHistory[(size_t)t*beamWidth+beam]=beamSymbols[beam];
+            parentHistory[(size_t)t*beamWidth+beam]=beamParents[beam];
+        }
+        activeBeamCount=newBeamCount;
+        if(t+1<length)
+            step(beamSymbols,beamParents);
+    }
+
+    // The beams are sorted by score, so beam 0 is the best hypothesis.
+    uint32_t beam=0;
+    for(uint32_t t=length;t>0;t--)
+    {
+        symbols[t-1]=symbolHistory[(size_t)(t-1)*beamWidth+beam];
+        beam=parentHistory[(size_t)(t-1)*beamWidth+beam];
+    }
+    free(symbolHistory);
+    free(parentHistory);
+    return length>0?beamScores[0]:0.0;
+}
+
+void RNNBeamSearch::addCandidateScores(uint32_t beam, const rnnfloat_t *outputs, uint32_t &candidateCount)
+{
+    // log(p)=log(output/sum(outputs)) for probabilities, and the log-softmax otherwise; only computed for the candidates.
+    bool hasProbabilities=(rnn->outputType==outputSoftmax);
+    double logSum;
+    if(hasProbabilities)
+    {
+        double sum=0.0;
+        for(uint32_t symbol=0;symbol<symbolCount;symbol++)
+            sum+=outputs[symbol];
+        logSum=log(sum);
+    }
+    else
+    {
+        double maxOutput=outputs[0];
+        for(uint32_t symbol=1;symbol<symbolCount;symbol++)
+            maxOutput=fmax(maxOutput,(double)outputs[symbol]);
+        double sum=0.0;
+        for(uint32_t symbol=0;symbol<symbolCount;symbol++)
+            sum+=exp(outputs[symbol]-maxOutput);
+        logSum=maxOutput+log(sum);
+    }
+
+    uint32_t *beamCandidates=candidates+candidateCount;
+    for(uint32_t symbol=0;symbol<symbolCount;symbol++)
+        beamCandidates[symbol]=symbol;
+    uint32_t beamCandidateCount=symbolCount;
+    if(beamWidth<symbolCount)
+    {
+        RNNBeamSearchOrder<rnnfloat_t> outputOrder;
+        outputOrder.values=outputs;
+        std::nth_element(beamCandidates,beamCandidates+beamWidth-1,beamCandidates+symbolCount,outputOrder);
+        beamCandidateCount=beamWidth;
+    }
+    size_t firstCandidate=(size_t)beam*symbolCount;
+    for(uint32_t i=0;i<beamCandidateCount;i++)
+    {
+        uint32_t symbol=beamCandidates[i];
+        double logProbability=(hasProbabilities?log(fmax((double)outputs[symbol],1e-300)):(double)outputs[symbol])-logSum;
+        candidateScores[firstCandidate+symbol]=beamScores[beam]+logProbability;
+        beamCandidates[i]=(uint32_t)(firstCandidate+symbol);
+    }
+    candidateCount+=beamCandidateCount;
+}
+
+void RNNBeamSearch::step(const uint32_t *inputSymbols, const uint32_t *previousBeams)
+{
+    // Like RNN::processIndexBatch(), with forked previous outputs
+    RNNState *newState=rnn->pushState();
+    rnn->copyPreviousOutputs(newState,previousBeams);
+    for(uint32_t beam=0;beam<beamWidth;beam++)
+        rnn->sparseFirstLayerForward(newState,beam,inputSymbols+beam,0,1);
+    rnn->forwardPass(newState,1,beamWidth);
+}
@@ -0,0 +1,45 @@
+#ifndef RNNBEAMSEARCH_H
+#define RNNBEAMSEARCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rnn.h"
+
+// Beam search decoder: finds a likely continuation of a prompt by keeping the "beamWidth" most probable hypotheses (sums of log
+// probabilities) of every length. The symbols are handled like in RNNGenerator (one-hot inputs and the first min(inputCount, outputCount)
+// outputs); outputs that are not probabilities (outputTanh) are turned into them by a softmax.
+// The recurrent state of this (Jordan-type) network is just the previous output, so a hypothesis is forked by copying that vector: the
+// beams are the sequences of one RNN with batch size "beamWidth" and no history, which shares the model's weights, and each step takes the
+// previous outputs of the beams' parents (RNN::copyPreviousOutputs()). All beams of a step are evaluated in one batched forward pass.
+
+class RNNBeamSearch
+{
+public:
+    RNN *rnn; // Owned; batch size beamWidth, inference only
+    uint32_t beamWidth;
+    uint32_t symbolCount;
+
+
+    // Feeds "prompt" (at least one symbol) and decodes "length" symbols into "symbols" (provided by the caller). Returns the log
+    // probability of the decoded symbols.
+    double decode(const uint32_t *prompt,uint32_t promptLength,uint32_t *symbols,uint32_t length);
+
+    RNNBeamSearch(RNN *model,uint32_t _beamWidth);
+    ~RNNBeamSearch();
+
+private:
+    // Dimensions: beams
+    double *beamScores; // Log probabilities of the hypotheses
+    uint32_t *beamSymbols; // Newest symbol of each hypothesis
+    uint32_t *beamParents; // Beam of the previous step that each hypothesis continues
+    // Dimensions: beams -> symbols; the scores of all extensions of all hypotheses
+    double *candidateScores;
+    uint32_t *candidates; // Indices into candidateScores
+
+    void addCandidateScores(uint32_t beam,const rnnfloat_t *outputs,uint32_t &candidateCount); // Appends the beam's candidates
+    void step(const uint32_t *inputSymbols,const uint32_t *previousBeams);
+};
+
+#endif // RNNBEAMSEARCH_H
@@ -0,0 +1,275 @@
+#include "rnncheckpoint.h"
+
+bool RNNCheckpoint::save(RNN *rnn, const char *fileName, bool includeHistory)
+{
+    if(!rnn->ownsWeights||rnn->previousWeightDiff==0)
+        throw;
+    includeHistory=includeHistory&&rnn->storedStateCount>0;
+    size_t neuronValueCount=getNeuronValueCount(rnn->states[0]);
+
+    fs_t bufferSize=256;
+    char *buffer=(char*)malloc(bufferSize);
+    fs_t pos=0;
+    io::writeRawDataToBuffer(buffer,RNNCHECKPOINT_MAGIC,8,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,RNNCHECKPOINT_VERSION,pos,bufferSize);
+    fs_t headerSizePos=pos;
+    io::writeUInt32ToBuffer(buffer,0,pos,bufferSize); // Header size, put below
+    fs_t headerPos=pos;
+
+    io::writeUInt32ToBuffer(buffer,sizeof(rnnfloat_t),pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->inputCount,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->outputCount,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->backpropagationSteps,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->batchSize,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->layerCount,pos,bufferSize);
+    for(uint32_t thisLayer=0;thisLayer<rnn->layerCount;thisLayer++)
+        io::writeUInt32ToBuffer(buffer,rnn->layerNeuronCounts[thisLayer],pos,bufferSize);
+    double hyperparameters[3]={rnn->learningRate,rnn->momentum,rnn->weightDecay};
+    for(uint32_t i=0;i<3;i++)
+    {
+        uint64_t bits;
+        memcpy(&bits,&hyperparameters[i],sizeof(uint64_t));
+        io::writeUInt64ToBuffer(buffer,bits,pos,bufferSize);
+    }
+    io::writeUInt32ToBuffer(buffer,rnn->kernelType,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->activationType,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->outputType,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->learningInterval,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->stepsSinceLearning,pos,bufferSize);
+    io::writeUInt64ToBuffer(buffer,rnn->forwardStepCount,pos,bufferSize);
+    io::writeUInt64ToBuffer(buffer,rnn->backwardStepCount,pos,bufferSize);
+    io::writeUInt64ToBuffer(buffer,rnn->weights->parameterCount,pos,bufferSize);
+    io::writeUInt8ToBuffer(buffer,includeHistory?1:0,pos,bufferSize);
+    if(includeHistory)
+    {
+        io::writeUInt32ToBuffer(buffer,rnn->stateArrayPos,pos,bufferSize);
+        io::writeUInt32ToBuffer(buffer,rnn->storedStateCount,pos,bufferSize);
+        io::writeUInt64ToBuffer(buffer,neuronValueCount,pos,bufferSize);
+        for(uint32_t state=0;state<rnn->stateArraySize;state++)
+            io::writeUInt8ToBuffer(buffer,rnn->states[state]->hasDesiredOutputs?1:0,pos,bufferSize);
+    }
+    io::putUInt32(buffer,pos-headerPos,headerSizePos);
+
+    FILE *file=fopen(fileName,"wb");
+    if(file==0)
+    {
+        free(buffer);
+        return false;
+    }
+    bool ok=(fwrite(buffer,1,pos,file)==pos);
+    free(buffer);
+
+    char *chunk=(char*)malloc(RNNCHECKPOINT_CHUNK_SIZE);
+    size_t parameterCount=rnn->weights->parameterCount;
+    ok=ok&&writeValues(file,rnn->weights->parameters,parameterCount,chunk);
+    ok=ok&&writeValues(file,rnn->previousWeightDiff->parameters,parameterCount,chunk);
+    if(includeHistory)
+    {
+        for(uint32_t state=0;state<rnn->stateArraySize;state++)
+        {
+            ok=ok&&writeValues(file,rnn->states[state]->neuronValues[0],neuronValueCount,chunk);
+            ok=ok&&writeValues(file,rnn->states[state]->desiredOutputs,(size_t)rnn->batchSize*rnn->outputCount,chunk);
+        }
+    }
+    free(chunk);
+    if(fclose(file)!=0)
+        ok=false;
+    return ok;
+}
+
+RNN *RNNCheckpoint::load(const char *fileName)
+{
+    FILE *file=fopen(fileName,"rb");
+    if(file==0)
+        return 0;
+
+    char start[16];
+    if(fread(start,1,16,file)!=16||memcmp(start,RNNCHECKPOINT_MAGIC,8)!=0)
+    {
+        fclose(file);
+        return 0;
+    }
+    char *data=start+8;
+    uint32_t version=io::readUInt32(data);
+    uint32_t headerSize=io::readUInt32(data);
+    if(version<1||version>RNNCHECKPOINT_VERSION||headerSize<24||headerSize>RNNCHECKPOINT_CHUNK_SIZE)
+    {
+        fclose(file);
+        return 0;
+    }
+    char *header=(char*)malloc(headerSize);
+    if(fread(header,1,headerSize,file)!=headerSize)
+    {
+        free(header);
+        fclose(file);
+        return 0;
+    }
+
+    data=header;
+    uint32_t valueSize=io::readUInt32(data);
+    uint32_t inputCount=io::readUInt32(data);
+    uint32_t outputCount=io::readUInt32(data);
+    uint32_t backpropagationSteps=io::readUInt32(data);
+    uint32_t batchSize=io::readUInt32(data);
+    uint32_t layerCount=io::readUInt32(data);
+    if(valueSize!=sizeof(rnnfloat_t)||layerCount<2||headerSize<24+(uint64_t)layerCount*sizeof(uint32_t)+(version>=2?69:65))
+    {
+        free(header);
+        fclose(file);
+        return 0;
+    }
+    uint32_t *layerNeuronCounts=(uint32_t*)malloc(layerCount*sizeof(uint32_t));
+    for(uint32_t thisLayer=0;thisLayer<layerCount;thisLayer++)
+        layerNeuronCounts[thisLayer]=io::readUInt32(data);
+    double hyperparameters[3];
+    for(uint32_t i=0;i<3;i++)
+    {
+        uint64_t bits=io::readUInt64(data);
+        memcpy(&hyperparameters[i],&bits,sizeof(uint64_t));
+    }
+    RNNKernelType kernelType=(RNNKernelType)io::readUInt32(data);
+    uint32_t activationType=io::readUInt32(data);
+    uint32_t outputType=(version>=2?io::readUInt32(data):(uint32_t)outputTanh);
+    uint32_t learningInterval=io::readUInt32(data);
+    uint32_t stepsSinceLearning=io::readUInt32(data);
+    uint64_t forwardStepCount=io::readUInt64(data);
+    uint64_t backwardStepCount=io::readUInt64(data);
+    uint64_t parameterCount=io::readUInt64(data);
+    bool hasHistory=(io::readUInt8(data)!=0);
+
+    // Everything the RNN is constructed from is checked first, so that a corrupt file cannot make the constructor throw or allocate huge
+    // amounts of memory; the values must be present in the file.
+    bool ok=(batchSize>0&&backpropagationSteps<UINT32_MAX&&(uint64_t)layerNeuronCounts[0]==(uint64_t)inputCount+outputCount&&
+             layerNeuronCounts[layerCount-1]==outputCount&&activationType<=activationNone&&outputType<=outputSoftmax&&
+             learningInterval<=(uint64_t)backpropagationSteps+1&&stepsSinceLearning<=learningInterval&&
+             (!hasHistory||(uint64_t)backpropagationSteps+1<=headerSize)); // With the history, the header has a flag per state.
+    uint64_t valuesPerState=(uint64_t)inputCount+2*(uint64_t)outputCount; // Neuron values, previous output and desired output (roughly)
+    for(uint32_t thisLayer=0;thisLayer<layerCount&&ok;thisLayer++)
+    {
+        ok=(layerNeuronCounts[thisLayer]>0&&layerNeuronCounts[thisLayer]<=RNNCHECKPOINT_MAX_LAYER_SIZE);
+        valuesPerState+=layerNeuronCounts[thisLayer];
+    }
+    ok=ok&&((uint64_t)backpropagationSteps+1)*batchSize<=RNNCHECKPOINT_MAX_STATE_VALUES/valuesPerState;
+    if(ok)
+    {
+        size_t *weightOffsets=(size_t*)malloc((layerCount-1)*sizeof(size_t));
+        size_t *biasWeightOffsets=(size_t*)malloc((layerCount-1)*sizeof(size_t));
+        uint32_t *weightRowStrides=(uint32_t*)malloc((layerCount-1)*sizeof(uint32_t));
+        ok=(parameterCount==RNNWeights::computeParameterLayout(layerCount,layerNeuronCounts,weightOffsets,biasWeightOffsets,weightRowStrides));
+        free(weightOffsets);
+        free(biasWeightOffsets);
+        free(weightRowStrides);
+    }
+    if(ok)
+    {
+        // Weights and momentum terms
+        long valuesStart=ftell(file);
+        ok=(valuesStart>=0&&fseek(file,0,SEEK_END)==0);
+        long fileSize=ok?ftell(file):-1;
+        ok=ok&&fileSize>=valuesStart&&(uint64_t)(fileSize-valuesStart)/(2*sizeof(rnnfloat_t))>=parameterCount&&fseek(file,valuesStart,SEEK_SET)==0;
+    }
+    if(!ok)
+    {
+        free(layerNeuronCounts);
+        free(header);
+        fclose(file);
+        return 0;
+    }
+
+    // The weights are created without randomization (they are overwritten anyway), so the RNN is given them as shared weights first.
+    RNNWeights *weights=new RNNWeights(layerCount,layerNeuronCounts,false);
+    RNN *rnn=new RNN(inputCount,outputCount,backpropagationSteps,hyperparameters[0],hyperparameters[1],hyperparameters[2],layerCount,layerNeuronCounts,batchSize,weights);
+    free(layerNeuronCounts);
+    rnn->ownsWeights=true;
+    rnn->previousWeightDiff=new RNNWeights(layerCount,rnn->layerNeuronCounts,false);
+    rnn->accumulatedWeightDiff=new RNNWeights(layerCount,rnn->layerNeuronCounts,false);
+
+    if(RNNKernels::isKernelTypeSupported(kernelType))
+        rnn->kernelType=kernelType;
+    rnn->activationType=(RNNActivationType)activationType;
+    rnn->outputType=(RNNOutputType)outputType;
+    rnn->learningInterval=learningInterval;
+    rnn->stepsSinceLearning=stepsSinceLearning;
+    rnn->forwardStepCount=forwardStepCount;
+    rnn->backwardStepCount=backwardStepCount;
+    size_t neuronValueCount=getNeuronValueCount(rnn->states[0]);
+    ok=ok&&parameterCount==weights->parameterCount&&headerSize==(uint32_t)(data-header)+(hasHistory?16+rnn->stateArraySize:0);
+    if(ok&&hasHistory)
+    {
+        rnn->stateArrayPos=io::readUInt32(data);
+        rnn->storedStateCount=io::readUInt32(data);
+        ok=(io::readUInt64(data)==neuronValueCount&&rnn->stateArrayPos<rnn->stateArraySize&&rnn->storedStateCount<=rnn->stateArraySize);
+        for(uint32_t state=0;state<rnn->stateArraySize;state++)
+            rnn->states[state]->hasDesiredOutputs=(io::readUInt8(data)!=0);
+    }
+    else
+        rnn->stepsSinceLearning=0; // New sequence
+    free(header);
+
+    char *chunk=(char*)malloc(RNNCHECKPOINT_CHUNK_SIZE);
+    ok=ok&&readValues(file,weights->parameters,parameterCount,chunk);
+    ok=ok&&readValues(file,rnn->previousWeightDiff->parameters,parameterCount,chunk);
+    if(hasHistory)
+    {
+        for(uint32_t state=0;state<rnn->stateArraySize;state++)
+        {
+            ok=ok&&readValues(file,rnn->states[state]->neuronValues[0],neuronValueCount,chunk);
+            ok=ok&&readValues(file,rnn->states[state]->desiredOutputs,(size_t)batchSize*outputCount,chunk);
+        }
+    }
+    free(chunk);
+    fclose(file);
+    if(!ok)
+    {
+        delete rnn;
+        return 0;
+    }
+    return rnn;
+}
+
+size_t RNNCheckpoint::getNeuronValueCount(RNNState *state)
+{
+    // All layers share one block (see RNNState).
+    size_t neuronValueCount=0;
+    for(uint32_t thisLayer=0;thisLayer<state->layerCount;thisLayer++)
+        neuronValueCount+=(size_t)state->neuronValueStrides[thisLayer]*state->batchSize;
+    return neuronValueCount;
+}
+
+bool RNNCheckpoint::writeValues(FILE *file, const rnnfloat_t *values, size_t count, char *chunk)
+{
+    size_t chunkValueCount=RNNCHECKPOINT_CHUNK_SIZE/sizeof(rnnfloat_t);
+    while(count>0)
+    {
+        size_t valueCount=count<chunkValueCount?count:chunkValueCount;
+        fs_t pos=0;
+        if(sizeof(rnnfloat_t)==sizeof(double))
+            io::writeDoubleArray(chunk,(const double*)values,valueCount,pos);
+        else
+            io::writeFloatArray(chunk,(const float*)values,valueCount,pos);
+        if(fwrite(chunk,1,pos,file)!=pos)
+            return false;
+        values+=valueCount;
+        count-=valueCount;
+    }
+    return true;
+}
+
+bool RNNCheckpoint::readValues(FILE *file, rnnfloat_t *values, size_t count, char *chunk)
+{
+    size_t chunkValueCount=RNNCHECKPOINT_CHUNK_SIZE/sizeof(rnnfloat_t);
+    while(count>0)
+    {
+        size_t valueCount=count<chunkValueCount?count:chunkValueCount;
+        if(fread(chunk,sizeof(rnnfloat_t),valueCount,file)!=valueCount)
+            return false;
+        char *data=chunk;
+        if(sizeof(rnnfloat_t)==sizeof(double))
+            io::readDoubleArray(data,(double*)values,valueCount);
+        else
+            io::readFloatArray(data,(float*)values,valueCount);
+        values+=valueCount;
+        count-=valueCount;
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef RNNCHECKPOINT_H
+#define RNNCHECKPOINT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "io.h"
+#include "rnn.h"
+
+#define RNNCHECKPOINT_MAGIC "RNNCHKPT" // 8 bytes, not terminated in the file
+#define RNNCHECKPOINT_VERSION 2 // Version 1 (no outputType, i.e. outputTanh) can be loaded as well.
+#define RNNCHECKPOINT_CHUNK_SIZE (1<<20) // Bytes; the values are converted and written/read in chunks of this size. Also the maximum header size.
+#define RNNCHECKPOINT_MAX_LAYER_SIZE (1<<24) // Neurons; files with larger layers are rejected as corrupt.
+#define RNNCHECKPOINT_MAX_STATE_VALUES (1ULL<<28) // Values of the whole state ring (all steps and sequences); larger ones are rejected as corrupt.
+
+// Complete training snapshot of an RNN that owns its weights, in a versioned binary format (all numbers little-endian, written using io):
+//
+//   Magic (8 bytes), version (uint32), header size (uint32; the bytes that follow up to the values)
+//   Header: sizeof(rnnfloat_t), inputCount, outputCount, backpropagationSteps, batchSize, layerCount, layerNeuronCounts (uint32 each);
+//           learningRate, momentum, weightDecay (uint64, IEEE-754 bits); kernelType, activationType, outputType (since version 2),
+//           learningInterval, stepsSinceLearning (uint32 each); forwardStepCount, backwardStepCount, parameterCount (uint64 each); history flag (uint8). With history:
+//           stateArrayPos, storedStateCount (uint32 each), values per state (uint64), one hasDesiredOutputs flag per state (uint8 each).
+//   Values (IEEE-754 bits of rnnfloat_t, including the zero padding): weights, momentum terms (previousWeightDiff); with history, for
+//           every state of the ring in storage order: neuron values, desired outputs.
+//
+// The floating-point values are stored bit-exactly, so an RNN that is loaded from a checkpoint continues exactly like the one that was saved,
+// provided that the saved kernel type is supported by the CPU (otherwise, the best supported one is used and results differ in rounding)
+// and the history was included. Without the history, the loaded RNN starts a new sequence, like a fresh one.
+// The thread team is not part of the checkpoint. Loading requires the same rnnfloat_t as saving.
+
+class RNNCheckpoint
+{
+public:
+    static bool save(RNN *rnn,const char *fileName,bool includeHistory); // False if the file couldn't be written
+    static RNN *load(const char *fileName); // 0 if the file couldn't be read or isn't a compatible checkpoint; the RNN must be deleted.
+
+    // Values in the above format, converted in chunks; "chunk" must have RNNCHECKPOINT_CHUNK_SIZE bytes. Also used by RNNModelFile.
+    static bool writeValues(FILE *file,const rnnfloat_t *values,size_t count,char *chunk);
+    static bool readValues(FILE *file,rnnfloat_t *values,size_t count,char *chunk);
+
+private:
+    static size_t getNeuronValueCount(RNNState *state);
+};
+
+#endif // RNNCHECKPOINT_H
@@ -0,0 +1,274 @@
+#include "rnncorpusreader.h"
+
+#include <chrono>
+
+std::string RNNCorpusReport::toString()
+{
+    std::string out;
+    char *str=text::unsignedLongToString(byteCount);
+    out+="Bytes: ";
+    out+=str;
+    free(str);
+    str=text::unsignedLongToString(batchCount);
+    out+=", batches: ";
+    out+=str;
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(seconds,3);
+    out+=", time: ";
+    out+=str;
+    out+=" s";
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(bytesPerSecond,0);
+    out+=", throughput: ";
+    out+=str;
+    out+=" bytes/s";
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(waitSeconds,3);
+    out+=", waiting for data: ";
+    out+=str;
+    out+=" s";
+    free(str);
+    return out;
+}
+
+RNNCorpusReader::RNNCorpusReader(const char *alphabet, uint32_t _batchSize, uint32_t _stepCount)
+{
+    batchSize=_batchSize;
+    stepCount=_stepCount;
+    if(batchSize==0||stepCount==0)
+        throw;
+
+    symbolBytes=(uint8_t*)malloc(256);
+    symbolCount=0;
+    for(uint32_t i=0;i<256;i++)
+        symbolIndices[i]=(alphabet==0?i:RNNCORPUSREADER_NO_SYMBOL);
+    if(alphabet==0)
+    {
+        for(uint32_t i=0;i<256;i++)
+            symbolBytes[symbolCount++]=(uint8_t)i;
+    }
+    else
+    {
+        for(const char *c=alphabet;*c!=0;c++)
+        {
+            if(symbolIndices[(uint8_t)*c]!=RNNCORPUSREADER_NO_SYMBOL)
+                continue; // Listed twice
+            symbolIndices[(uint8_t)*c]=symbolCount;
+            symbolBytes[symbolCount++]=(uint8_t)*c;
+        }
+    }
+    if(symbolCount==0)
+        throw;
+
+    // All batch buffers are allocated and zeroed once; filling a batch only moves the hot values.
+    size_t vectorCount=(size_t)stepCount*batchSize;
+    for(uint32_t b=0;b<RNNCORPUSREADER_BUFFER_COUNT;b++)
+    {
+        RNNCorpusBatch &batch=batches[b];
+        batch.inputs=(rnnfloat_t***)malloc(stepCount*sizeof(rnnfloat_t**));
+        batch.desiredOutputs=(rnnfloat_t***)malloc(stepCount*sizeof(rnnfloat_t**));
+        batch.inputIndices=(uint32_t**)malloc(stepCount*sizeof(uint32_t*));
+        batch.desiredOutputIndices=(uint32_t**)malloc(stepCount*sizeof(uint32_t*));
+        batch.inputs[0]=(rnnfloat_t**)malloc(vectorCount*sizeof(rnnfloat_t*));
+        batch.desiredOutputs[0]=(rnnfloat_t**)malloc(vectorCount*sizeof(rnnfloat_t*));
+        batch.inputIndices[0]=(uint32_t*)malloc(vectorCount*sizeof(uint32_t));
+        batch.desiredOutputIndices[0]=(uint32_t*)malloc(vectorCount*sizeof(uint32_t));
+        rnnfloat_t *inputValues=(rnnfloat_t*)calloc(vectorCount*symbolCount,sizeof(rnnfloat_t));
+        rnnfloat_t *desiredOutputValues=(rnnfloat_t*)calloc(vectorCount*symbolCount,sizeof(rnnfloat_t));
+        for(uint32_t step=0;step<stepCount;step++)
+        {
+            batch.inputs[step]=batch.inputs[0]+(size_t)step*batchSize;
+            batch.desiredOutputs[step]=batch.desiredOutputs[0]+(size_t)step*batchSize;
+            batch.inputIndices[step]=batch.inputIndices[0]+(size_t)step*batchSize;
+            batch.desiredOutputIndices[step]=batch.desiredOutputIndices[0]+(size_t)step*batchSize;
+            for(uint32_t sequence=0;sequence<batchSize;sequence++)
+            {
+                size_t vector=(size_t)step*batchSize+sequence;
+                batch.inputs[step][sequence]=inputValues+vector*symbolCount;
+                batch.desiredOutputs[step][sequence]=desiredOutputValues+vector*symbolCount;
+                batch.inputIndices[step][sequence]=0;
+                batch.desiredOutputIndices[step][sequence]=0;
+            }
+        }
+        batchReady[b]=false;
+    }
+    currentBatch=RNNCORPUSREADER_BUFFER_COUNT;
+    positions=(uint64_t*)malloc(batchSize*sizeof(uint64_t));
+    currentSymbols=(uint32_t*)malloc(batchSize*sizeof(uint32_t));
+    prefetchThread=0;
+    stopping=false;
+    byteCount=0;
+    batchCount=0;
+    waitSeconds=0.0;
+    startTime=0.0;
+}
+
+RNNCorpusReader::~RNNCorpusReader()
+{
+    close();
+    for(uint32_t b=0;b<RNNCORPUSREADER_BUFFER_COUNT;b++)
+    {
+        RNNCorpusBatch &batch=batches[b];
+        free(batch.inputs[0][0]);
+        free(batch.desiredOutputs[0][0]);
+        free(batch.inputs[0]);
+        free(batch.desiredOutputs[0]);
+        free(batch.inputIndices[0]);
+        free(batch.desiredOutputIndices[0]);
+        free(batch.inputs);
+        free(batch.desiredOutputs);
+        free(batch.inputIndices);
+        free(batch.desiredOutputIndices);
+    }
+    free(positions);
+    free(currentSymbols);
+    free(symbolBytes);
+}
+
+bool RNNCorpusReader::open(const char *fileName)
+{
+    close();
+    if(!file.open(fileName))
+        return false;
+    // A corpus without any symbol would make the streams loop forever.
+    bool hasSymbol=false;
+    for(uint64_t pos=0;pos<file.size&&!hasSymbol;pos++)
+        hasSymbol=(symbolIndices[(uint8_t)file.data[pos]]!=RNNCORPUSREADER_NO_SYMBOL);
+    if(!hasSymbol)
+    {
+        file.close();
+        return false;
+    }
+    file.adviseSequential(); // Every stream reads front to back.
+
+    byteCount=0;
+    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+    {
+        positions[sequence]=file.size*sequence/batchSize;
+        currentSymbols[sequence]=readSymbol(sequence);
+    }
+    for(uint32_t b=0;b<RNNCORPUSREADER_BUFFER_COUNT;b++)
+        batchReady[b]=false;
+    currentBatch=RNNCORPUSREADER_BUFFER_COUNT;
+    batchCount=0;
+    waitSeconds=0.0;
+    startTime=getTime();
+    stopping=false;
+    prefetchThread=new std::thread(&RNNCorpusReader::prefetchLoop,this);
+    return true;
+}
+
+void RNNCorpusReader::close()
+{
+    if(prefetchThread!=0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(batchMutex);
+            stopping=true;
+        }
+        batchCondition.notify_all();
+        prefetchThread->join();
+        delete prefetchThread;
+        prefetchThread=0;
+    }
+    file.close();
+}
+
+RNNCorpusBatch *RNNCorpusReader::nextBatch()
+{
+    if(prefetchThread==0)
+        throw; // Not open
+    double waitStartTime=getTime();
+    {
+        std::unique_lock<std::mutex> lock(batchMutex);
+        uint32_t nextBatchIndex=0;
+        if(currentBatch<RNNCORPUSREADER_BUFFER_COUNT)
+        {
+            batchReady[currentBatch]=false; // Released; the prefetch thread can refill it.
+            batchCondition.notify_all();
+            nextBatchIndex=(currentBatch+1)%RNNCORPUSREADER_BUFFER_COUNT;
+        }
+        while(!batchReady[nextBatchIndex])
+            batchCondition.wait(lock);
+        currentBatch=nextBatchIndex;
+    }
+    waitSeconds+=getTime()-waitStartTime;
+    batchCount++;
+    return &batches[currentBatch];
+}
+
+RNNCorpusReport RNNCorpusReader::getReport()
+{
+    RNNCorpusReport report;
+    report.byteCount=byteCount;
+    report.batchCount=batchCount;
+    report.seconds=getTime()-startTime;
+    report.bytesPerSecond=report.seconds>0.0?(double)report.byteCount/report.seconds:0.0;
+    report.waitSeconds=waitSeconds;
+    return report;
+}
+
+double RNNCorpusReader::getTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t RNNCorpusReader::readSymbol(uint32_t sequence)
+{
+    // open() made sure that there is at least one symbol.
+    uint64_t pos=positions[sequence];
+    uint32_t symbol;
+    uint64_t readByteCount=0;
+    do
+    {
+        symbol=symbolIndices[(uint8_t)file.data[pos]];
+        pos++;
+        if(pos==file.size)
+            pos=0;
+        readByteCount++;
+    }
+    while(symbol==RNNCORPUSREADER_NO_SYMBOL);
+    positions[sequence]=pos;
+    byteCount+=readByteCount;
+    return symbol;
+}
+
+void RNNCorpusReader::fillBatch(RNNCorpusBatch *batch)
+{
+    for(uint32_t step=0;step<stepCount;step++)
+    {
+        for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        {
+            // Only the previously hot values need to be cleared.
+            uint32_t inputIndex=currentSymbols[sequence];
+            uint32_t desiredOutputIndex=readSymbol(sequence);
+            currentSymbols[sequence]=desiredOutputIndex;
+            batch->inputs[step][sequence][batch->inputIndices[step][sequence]]=0.0;
+            batch->inputs[step][sequence][inputIndex]=1.0;
+            batch->inputIndices[step][sequence]=inputIndex;
+            batch->desiredOutputs[step][sequence][batch->desiredOutputIndices[step][sequence]]=0.0;
+            batch->desiredOutputs[step][sequence][desiredOutputIndex]=1.0;
+            batch->desiredOutputIndices[step][sequence]=desiredOutputIndex;
+        }
+    }
+}
+
+void RNNCorpusReader::prefetchLoop()
+{
+    for(uint32_t fillBatchIndex=0;;fillBatchIndex=(fillBatchIndex+1)%RNNCORPUSREADER_BUFFER_COUNT)
+    {
+        {
+            std::unique_lock<std::mutex> lock(batchMutex);
+            while(batchReady[fillBatchIndex]&&!stopping)
+                batchCondition.wait(lock);
+            if(stopping)
+                return;
+        }
+        fillBatch(&batches[fillBatchIndex]);
+        {
+            std::lock_guard<std::mutex> lock(batchMutex);
+            batchReady[fillBatchIndex]=true;
+        }
+        batchCondition.notify_all();
+    }
+}
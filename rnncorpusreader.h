@@ -0,0 +1,98 @@
+#ifndef RNNCORPUSREADER_H
+#define RNNCORPUSREADER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "mappedfile.h"
+#include "rnnkernels.h" // rnnfloat_t
+#include "text.h"
+
+#define RNNCORPUSREADER_NO_SYMBOL 0xffffffff
+#define RNNCORPUSREADER_BUFFER_COUNT 2 // The batch that is in use plus the one that is being prepared
+
+// One batch of training data: "stepCount" steps of "batchSize" sequences, one-hot encoded. The desired output of a step is the input of the
+// next step of the same sequence, i.e. the next symbol.
+struct RNNCorpusBatch
+{
+    // Dimensions: steps -> sequences -> values (symbolCount each); inputs[step] can be passed to RNN::processBatch() directly and
+    // desiredOutputs[step] to RNN::setDesiredOutputs().
+    rnnfloat_t ***inputs;
+    rnnfloat_t ***desiredOutputs;
+    // Dimensions: steps -> sequences; the indices of the hot values
+    uint32_t **inputIndices;
+    uint32_t **desiredOutputIndices;
+};
+
+// Result of RNNCorpusReader::getReport()
+struct RNNCorpusReport
+{
+    uint64_t byteCount; // Bytes read from the corpus, including skipped ones
+    uint64_t batchCount; // Batches returned by nextBatch()
+    double seconds; // Since open()
+    double bytesPerSecond;
+    double waitSeconds; // Time that nextBatch() spent waiting for the prefetch thread
+
+    std::string toString();
+};
+
+// Streams training data from a corpus file of any size: the file is mapped (see MappedFile), so it doesn't need to fit into the RAM and
+// is never copied, and the batches are encoded by a prefetch thread while the caller trains on the previous batch.
+// The corpus is read as "batchSize" independent streams that start at evenly spaced offsets (sequence "s" at s*size/batchSize) and wrap
+// around at the end of the file, so every sequence sees contiguous text. Bytes are mapped to symbols by an alphabet; bytes that are not
+// part of it are skipped.
+
+class RNNCorpusReader
+{
+public:
+    MappedFile file;
+    uint32_t symbolIndices[256]; // Byte -> symbol index; RNNCORPUSREADER_NO_SYMBOL for bytes that are skipped
+    uint8_t *symbolBytes; // Dimensions: symbols; symbol index -> byte
+    uint32_t symbolCount; // Values per input/desired output vector
+    uint32_t batchSize;
+    uint32_t stepCount; // Steps per batch
+
+
+    bool open(const char *fileName); // Starts the prefetch thread. False if the file couldn't be mapped or contains no symbol.
+    void close();
+
+    // Waits until the next batch is ready, if needed. The returned batch stays valid until the next call, after which it is refilled.
+    RNNCorpusBatch *nextBatch();
+    RNNCorpusReport getReport();
+
+    // "alphabet": the bytes that make up the symbols, in the order of their indices (zero-terminated); 0: all 256 byte values, with
+    // index=byte.
+    RNNCorpusReader(const char *alphabet,uint32_t _batchSize,uint32_t _stepCount);
+    ~RNNCorpusReader();
+
+private:
+    RNNCorpusBatch batches[RNNCORPUSREADER_BUFFER_COUNT];
+    bool batchReady[RNNCORPUSREADER_BUFFER_COUNT]; // Guarded by "batchMutex"
+    uint32_t currentBatch; // Index of the batch that the caller uses; RNNCORPUSREADER_BUFFER_COUNT before the first nextBatch() call
+    uint64_t *positions; // Dimensions: sequences; the position of the next byte of each stream (prefetch thread only)
+    uint32_t *currentSymbols; // Dimensions: sequences; the symbol that will be the next input of each stream (prefetch thread only)
+
+    std::thread *prefetchThread;
+    std::mutex batchMutex;
+    std::condition_variable batchCondition;
+    bool stopping; // Guarded by "batchMutex"
+
+    std::atomic<uint64_t> byteCount;
+    uint64_t batchCount;
+    double waitSeconds;
+    double startTime; // Seconds, steady clock
+
+    static double getTime();
+    uint32_t readSymbol(uint32_t sequence);
+    void fillBatch(RNNCorpusBatch *batch);
+    void prefetchLoop();
+};
+
+#endif // RNNCORPUSREADER_H
@@ -0,0 +1,173 @@
+#include "rnngenerator.h"
+
+#include <algorithm>
+#include <chrono>
+
+std::string RNNGenerationReport::toString()
+{
+    std::string out;
+    char *str=text::unsignedLongToString(symbolCount);
+    out+="Generated symbols: ";
+    out+=str;
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(seconds,3);
+    out+=", time: ";
+    out+=str;
+    out+=" s";
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(symbolsPerSecond,0);
+    out+=", throughput: ";
+    out+=str;
+    out+=" symbols/s";
+    free(str);
+    return out;
+}
+
+// Orders symbol indices by probability, descending
+struct RNNGeneratorCandidateOrder
+{
+    const rnnfloat_t *probabilities;
+
+    bool operator()(uint32_t a,uint32_t b) const
+    {
+        return probabilities[a]>probabilities[b];
+    }
+};
+
+RNNGenerator::RNNGenerator(RNN *model)
+{
+    rnn=new RNN(model->inputCount,model->outputCount,0 /*No history*/,0.0,0.0,0.0,model->layerCount,model->layerNeuronCounts,1,model->weights);
+    rnn->kernelType=model->kernelType;
+    rnn->activationType=model->activationType;
+    rnn->outputType=model->outputType;
+    rnn->threadTeam=model->threadTeam;
+    rnn->setInferenceOnly();
+    symbolCount=model->inputCount<model->outputCount?model->inputCount:model->outputCount;
+    if(symbolCount==0)
+        throw;
+
+    temperature=1.0;
+    topK=0;
+    topP=1.0;
+    setSeed(1);
+    probabilities=(rnnfloat_t*)malloc(symbolCount*sizeof(rnnfloat_t));
+    candidates=(uint32_t*)malloc(symbolCount*sizeof(uint32_t));
+    generatedSymbolCount=0;
+    generationSeconds=0.0;
+}
+
+RNNGenerator::~RNNGenerator()
+{
+    delete rnn;
+    free(probabilities);
+    free(candidates);
+}
+
+void RNNGenerator::setSeed(uint64_t seed)
+{
+    randomState=seed!=0?seed:0x9e3779b97f4a7c15ULL; // xorshift requires a nonzero state.
+}
+
+void RNNGenerator::reset()
+{
+    rnn->startNewSequence();
+}
+
+void RNNGenerator::feed(const uint32_t *symbols, uint32_t count)
+{
+    for(uint32_t i=0;i<count;i++)
+        rnn->stepIndex(symbols[i]);
+}
+
+void RNNGenerator::generate(uint32_t *symbols, uint32_t count)
+{
+    if(!rnn->hasState(0))
+        throw; // Nothing fed yet
+    std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+    const rnnfloat_t *outputs=rnn->getCurrentState()->getOutput(0);
+    for(uint32_t i=0;i<count;i++)
+    {
+        symbols[i]=sampleSymbol(outputs);
+        outputs=rnn->stepIndex(symbols[i]);
+    }
+    generationSeconds+=std::chrono::duration<double>(std::chrono::steady_clock::now()-startTime).count();
+    generatedSymbolCount+=count;
+}
+
+uint32_t RNNGenerator::sampleSymbol(const rnnfloat_t *outputs)
+{
+    if(temperature<=0.0)
+    {
+        uint32_t highestSymbol=0;
+        for(uint32_t symbol=1;symbol<symbolCount;symbol++)
+        {
+            if(outputs[symbol]>outputs[highestSymbol])
+                highestSymbol=symbol;
+        }
+        return highestSymbol;
+    }
+
+    bool hasProbabilities=(rnn->outputType==outputSoftmax);
+    if(hasProbabilities&&temperature==1.0)
+        memcpy(probabilities,outputs,symbolCount*sizeof(rnnfloat_t)); // Normalized below (the symbols may not be all outputs)
+    else
+    {
+        double inverseTemperature=fmin(1.0/temperature,RNNGENERATOR_MAX_INVERSE_TEMPERATURE); // Also for denormal (1/t=inf) and NaN temperatures
+        for(uint32_t symbol=0;symbol<symbolCount;symbol++)
+            probabilities[symbol]=(rnnfloat_t)((hasProbabilities?log(fmax((double)outputs[symbol],1e-30)):(double)outputs[symbol])*inverseTemperature);
+        RNNActivation::softmaxArray(rnn->activationType,rnn->kernelType,probabilities,symbolCount);
+    }
+
+    // Only the candidates that can be drawn are sorted: the topK most probable ones, or all of them for nucleus sampling.
+    uint32_t candidateCount=symbolCount;
+    for(uint32_t symbol=0;symbol<symbolCount;symbol++)
+        candidates[symbol]=symbol;
+    RNNGeneratorCandidateOrder order;
+    order.probabilities=probabilities;
+    if(topK>0&&topK<symbolCount)
+    {
+        std::partial_sort(candidates,candidates+topK,candidates+symbolCount,order);
+        candidateCount=topK;
+    }
+    else if(topP<1.0)
+        std::sort(candidates,candidates+symbolCount,order);
+    double total=0.0;
+    for(uint32_t candidate=0;candidate<candidateCount;candidate++)
+        total+=probabilities[candidates[candidate]];
+    if(topP<1.0)
+    {
+        double nucleusTotal=0.0;
+        uint32_t nucleusCount=0;
+        while(nucleusCount<candidateCount&&(nucleusCount==0||nucleusTotal<topP*total))
+            nucleusTotal+=probabilities[candidates[nucleusCount++]];
+        candidateCount=nucleusCount;
+        total=nucleusTotal;
+    }
+
+    double threshold=nextRandom()*total;
+    double sum=0.0;
+    for(uint32_t candidate=0;candidate<candidateCount-1;candidate++)
+    {
+        sum+=probabilities[candidates[candidate]];
+        if(threshold<sum)
+            return candidates[candidate];
+    }
+    return candidates[candidateCount-1]; // Also catches rounding at the end
+}
+
+RNNGenerationReport RNNGenerator::getReport()
+{
+    RNNGenerationReport report;
+    report.symbolCount=generatedSymbolCount;
+    report.seconds=generationSeconds;
+    report.symbolsPerSecond=generationSeconds>0.0?(double)generatedSymbolCount/generationSeconds:0.0;
+    return report;
+}
+
+double RNNGenerator::nextRandom()
+{
+    randomState^=randomState>>12;
+    randomState^=randomState<<25;
+    randomState^=randomState>>27;
+    return (double)((randomState*0x2545f4914f6cdd1dULL)>>11)*(1.0/9007199254740992.0); // 53 random bits
+}
@@ -0,0 +1,69 @@
+#ifndef RNNGENERATOR_H
+#define RNNGENERATOR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "rnn.h"
+#include "text.h"
+
+#define RNNGENERATOR_MAX_INVERSE_TEMPERATURE 1e6 // Tiny temperatures are clamped to this; any smaller one is practically greedy.
+
+// Result of RNNGenerator::getReport()
+struct RNNGenerationReport
+{
+    uint64_t symbolCount; // Generated symbols (fed ones not included)
+    double seconds; // Time spent in generate()
+    double symbolsPerSecond;
+
+    std::string toString();
+};
+
+// Generates symbol sequences with a trained RNN: every generated symbol is sampled from the outputs and fed back as the next input (one-hot,
+// see RNN::stepIndex()). The symbols are the indices of the first min(inputCount, outputCount) outputs and inputs; additional outputs (e.g.
+// memory neurons) are ignored.
+// The generator steps its own RNN, which shares the model's weights but has no history (a single state record), so a step does not
+// maintain anything for BPTT. Further training of the model affects the generated symbols immediately.
+//
+// Sampling: the outputs are turned into probabilities by a softmax of score/temperature, where the score is log(output) for softmax output
+// layers (i.e. probabilities are raised to the power of 1/temperature) and the output value itself otherwise. Then only the topK most
+// probable symbols are kept, and of those the smallest set whose probabilities sum up to at least topP of the remaining total (nucleus).
+
+class RNNGenerator
+{
+public:
+    RNN *rnn; // Owned; inference only
+    uint32_t symbolCount;
+
+    double temperature; // Defaults to 1.0; 0: always the most probable symbol (greedy)
+    uint32_t topK; // Defaults to 0 (all symbols)
+    double topP; // Defaults to 1.0 (all symbols)
+
+
+    void setSeed(uint64_t seed); // The sequence of random numbers; defaults to a fixed seed, so that generation is reproducible.
+    void reset(); // Starts a new sequence; the report is kept.
+
+    // Feeds symbols (e.g. a prompt or a start symbol) without sampling; at least one symbol must be fed before generate().
+    void feed(const uint32_t *symbols,uint32_t count);
+    // Samples "count" symbols into "symbols" (provided by the caller); each one is fed back, so generation can continue with another call.
+    void generate(uint32_t *symbols,uint32_t count);
+    uint32_t sampleSymbol(const rnnfloat_t *outputs); // Draws one symbol from an output vector using the settings above.
+
+    RNNGenerationReport getReport();
+
+    RNNGenerator(RNN *model);
+    ~RNNGenerator();
+
+private:
+    uint64_t randomState; // xorshift64*
+    rnnfloat_t *probabilities; // Dimensions: symbols
+    uint32_t *candidates; // Dimensions: symbols; symbol indices, sorted by probability (descending) as far as needed
+    uint64_t generatedSymbolCount;
+    double generationSeconds;
+
+    double nextRandom(); // Uniform in [0, 1)
+};
+
+#endif // RNNGENERATOR_H
@@ -0,0 +1,545 @@
+#include "rnnkernels.h"
+#include "rnnactivation.h"
+#include "alignedmemory.h"
+
+#include <string.h>
+
+#ifdef RNNKERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+RNNKernelType RNNKernels::detectBestKernelType()
+{
+    if(isKernelTypeSupported(kernelAVX512))
+        return kernelAVX512;
+    if(isKernelTypeSupported(kernelAVX2))
+        return kernelAVX2;
+    return kernelScalar;
+}
+
+bool RNNKernels::isKernelTypeSupported(RNNKernelType kernelType)
+{
+    if(kernelType==kernelScalar)
+        return true;
+#ifdef RNNKERNELS_X86
+#ifdef _MSC_VER
+    int cpuInfo[4];
+    __cpuid(cpuInfo,1);
+    bool osSavesYmm=(cpuInfo[2]&(1<<27)) /*OSXSAVE*/&&(_xgetbv(0)&0x6)==0x6;
+    bool hasFma=(cpuInfo[2]&(1<<12))!=0;
+    __cpuidex(cpuInfo,7,0);
+    bool hasAvx2=(cpuInfo[1]&(1<<5))!=0;
+    bool hasAvx512f=(cpuInfo[1]&(1<<16))!=0;
+    if(kernelType==kernelAVX2)
+        return osSavesYmm&&hasAvx2&&hasFma;
+    if(kernelType==kernelAVX512)
+        return osSavesYmm&&hasAvx512f&&(_xgetbv(0)&0xe6)==0xe6;
+#else
+    __builtin_cpu_init();
+    if(kernelType==kernelAVX2)
+        return __builtin_cpu_supports("avx2")&&__builtin_cpu_supports("fma");
+    if(kernelType==kernelAVX512)
+        return __builtin_cpu_supports("avx512f");
+#endif
+#endif
+    return false;
+}
+
+const char *RNNKernels::getKernelTypeName(RNNKernelType kernelType)
+{
+    switch(kernelType)
+    {
+    case kernelAVX2:
+        return "AVX2";
+    case kernelAVX512:
+        return "AVX-512";
+    default:
+        return "scalar";
+    }
+}
+
+void RNNKernels::layerForward(RNNKernelType kernelType, RNNActivationType activationType, const double *weights, uint32_t rowStride, const double *bias, const double *in, uint32_t inCount, double *out, uint32_t outCount)
+{
+    layerForwardBatch(kernelType,activationType,weights,rowStride,bias,in,inCount,out,outCount,outCount,1);
+}
+
+void RNNKernels::layerForwardBatch(RNNKernelType kernelType, RNNActivationType activationType, const double *weights, uint32_t rowStride, const double *bias, const double *in, uint32_t inCount, double *out, uint32_t outStride, uint32_t outCount, uint32_t batchSize)
+{
+    // The vectorized kernels run over the zero-padded row length, so they need no remainder handling for "in".
+#ifdef RNNKERNELS_X86
+    if(kernelType==kernelAVX512)
+        layerForwardBatchAVX512(weights,rowStride,alignedmemory::paddedCount(inCount,sizeof(*in)),bias,in,out,outStride,outCount,batchSize);
+    else if(kernelType==kernelAVX2)
+        layerForwardBatchAVX2(weights,rowStride,alignedmemory::paddedCount(inCount,sizeof(*in)),bias,in,out,outStride,outCount,batchSize);
+    else
+#endif
+        layerForwardBatchScalar(weights,rowStride,bias,in,inCount,out,outStride,outCount,batchSize);
+
+    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        RNNActivation::tanhArray(activationType,kernelType,out+(size_t)sequence*outStride,outCount);
+}
+
+void RNNKernels::layerForwardBatchScalar(const double *weights, uint32_t rowStride, const double *bias, const double *in, uint32_t inCount, double *out, uint32_t outStride, uint32_t outCount, uint32_t batchSize)
+{
+    for(uint32_t neuronInNextLayer=0;neuronInNextLayer<outCount;neuronInNextLayer++)
+    {
+        // All weights pointing to "neuronInNextLayer" are contiguous; the row stays in the cache while it is applied to all sequences.
+        const double *weightRow=weights+(size_t)neuronInNextLayer*rowStride;
+        for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        {
+            const double *valuesOfNeuronsInThisLayer=in+(size_t)sequence*rowStride;
+            double thisLayerNeuronValueMultipliedByWeightSum=0.0;
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<inCount;neuronInThisLayer++)
+                thisLayerNeuronValueMultipliedByWeightSum+=weightRow[neuronInThisLayer]*valuesOfNeuronsInThisLayer[neuronInThisLayer];
+            out[(size_t)sequence*outStride+neuronInNextLayer]=thisLayerNeuronValueMultipliedByWeightSum+bias[neuronInNextLayer];
+        }
+    }
+}
+
+void RNNKernels::layerForward(RNNKernelType kernelType, RNNActivationType activationType, const float *weights, uint32_t rowStride, const float *bias, const float *in, uint32_t inCount, float *out, uint32_t outCount)
+{
+    layerForwardBatch(kernelType,activationType,weights,rowStride,bias,in,inCount,out,outCount,outCount,1);
+}
+
+void RNNKernels::layerForwardBatch(RNNKernelType kernelType, RNNActivationType activationType, const float *weights, uint32_t rowStride, const float *bias, const float *in, uint32_t inCount, float *out, uint32_t outStride, uint32_t outCount, uint32_t batchSize)
+{
+#ifdef RNNKERNELS_X86
+    if(kernelType==kernelAVX512)
+        layerForwardBatchAVX512(weights,rowStride,alignedmemory::paddedCount(inCount,sizeof(*in)),bias,in,out,outStride,outCount,batchSize);
+    else if(kernelType==kernelAVX2)
+        layerForwardBatchAVX2(weights,rowStride,alignedmemory::paddedCount(inCount,sizeof(*in)),bias,in,out,outStride,outCount,batchSize);
+    else
+#endif
+        layerForwardBatchScalar(weights,rowStride,bias,in,inCount,out,outStride,outCount,batchSize);
+
+    for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        RNNActivation::tanhArray(activationType,kernelType,out+(size_t)sequence*outStride,outCount);
+}
+
+void RNNKernels::layerForwardBatchScalar(const float *weights, uint32_t rowStride, const float *bias, const float *in, uint32_t inCount, float *out, uint32_t outStride, uint32_t outCount, uint32_t batchSize)
+{
+    for(uint32_t neuronInNextLayer=0;neuronInNextLayer<outCount;neuronInNextLayer++)
+    {
+        const float *weightRow=weights+(size_t)neuronInNextLayer*rowStride;
+        for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        {
+            const float *valuesOfNeuronsInThisLayer=in+(size_t)sequence*rowStride;
+            float thisLayerNeuronValueMultipliedByWeightSum=0.0f;
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<inCount;neuronInThisLayer++)
+                thisLayerNeuronValueMultipliedByWeightSum+=weightRow[neuronInThisLayer]*valuesOfNeuronsInThisLayer[neuronInThisLayer];
+            out[(size_t)sequence*outStride+neuronInNextLayer]=thisLayerNeuronValueMultipliedByWeightSum+bias[neuronInNextLayer];
+        }
+    }
+}
+
+void RNNKernels::layerForwardQuantized(RNNKernelType kernelType, RNNActivationType activationType, const int8_t *weights, uint32_t rowStride, const rnnfloat_t *rowScales, const rnnfloat_t *bias, const int8_t *in, rnnfloat_t inScale, uint32_t inCount, rnnfloat_t *out, uint32_t outCount)
+{
+    // AVX-512F has no 8/16-bit integer arithmetic (that needs AVX-512BW), so the AVX2 kernel is used for kernelAVX512 as well.
+#ifdef RNNKERNELS_X86
+    if(kernelType!=kernelScalar)
+        layerForwardQuantizedAVX2(weights,rowStride,rowScales,bias,in,inScale,out,outCount);
+    else
+#endif
+        layerForwardQuantizedScalar(weights,rowStride,rowScales,bias,in,inScale,inCount,out,outCount);
+
+    RNNActivation::tanhArray(activationType,kernelType,out,outCount);
+}
+
+rnnfloat_t RNNKernels::quantizeValues(const rnnfloat_t *in, int8_t *out, uint32_t count)
+{
+    rnnfloat_t maxAbsoluteValue=0.0;
+    for(uint32_t i=0;i<count;i++)
+    {
+        if(fabs(in[i])>maxAbsoluteValue)
+            maxAbsoluteValue=fabs(in[i]);
+    }
+    if(maxAbsoluteValue==0.0)
+    {
+        memset(out,0,count);
+        return 0.0;
+    }
+    rnnfloat_t inverseScale=127.0/maxAbsoluteValue;
+    for(uint32_t i=0;i<count;i++)
+        out[i]=(int8_t)lrint(in[i]*inverseScale); // Within [-127, 127]
+    return maxAbsoluteValue/127.0;
+}
+
+void RNNKernels::layerForwardQuantizedScalar(const int8_t *weights, uint32_t rowStride, const rnnfloat_t *rowScales, const rnnfloat_t *bias, const int8_t *in, rnnfloat_t inScale, uint32_t inCount, rnnfloat_t *out, uint32_t outCount)
+{
+    for(uint32_t neuronInNextLayer=0;neuronInNextLayer<outCount;neuronInNextLayer++)
+    {
+        const int8_t *weightRow=weights+(size_t)neuronInNextLayer*rowStride;
+        int32_t sum=0;
+        for(uint32_t neuronInThisLayer=0;neuronInThisLayer<inCount;neuronInThisLayer++)
+            sum+=(int32_t)weightRow[neuronInThisLayer]*(int32_t)in[neuronInThisLayer];
+        out[neuronInNextLayer]=(rnnfloat_t)sum*rowScales[neuronInNextLayer]*inScale+bias[neuronInNextLayer];
+    }
+}
+
+#ifdef RNNKERNELS_X86
+
+RNNKERNELS_TARGET_AVX2 static inline double horizontalSumAVX2(__m256d sum)
+{
+    __m128d halves=_mm_add_pd(_mm256_castpd256_pd128(sum),_mm256_extractf128_pd(sum,1));
+    return _mm_cvtsd_f64(_mm_add_sd(halves,_mm_unpackhi_pd(halves,halves)));
+}
+
+RNNKERNELS_TARGET_AVX2 static inline __m256d horizontalSumsAVX2(__m256d sum0, __m256d sum1, __m256d sum2, __m256d sum3)
+{
+    // Reduces four accumulators to one vector holding the four sums.
+    __m256d sum01=_mm256_hadd_pd(sum0,sum1);
+    __m256d sum23=_mm256_hadd_pd(sum2,sum3);
+    return _mm256_add_pd(_mm256_permute2f128_pd(sum01,sum23,0x20),_mm256_permute2f128_pd(sum01,sum23,0x31));
+}
+
+RNNKERNELS_TARGET_AVX512 static inline double horizontalSumAVX512(__m512d sum)
+{
+    // Going through memory avoids the shuffle intrinsics, which trigger spurious -Wmaybe-uninitialized warnings in some GCC versions.
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes,sum);
+    return ((lanes[0]+lanes[1])+(lanes[2]+lanes[3]))+((lanes[4]+lanes[5])+(lanes[6]+lanes[7]));
+}
+
+RNNKERNELS_TARGET_AVX2 void RNNKernels::layerForwardBatchAVX2(const double *weights, uint32_t rowStride, uint32_t paddedInCount, const double *bias, const double *in, double *out, uint32_t outStride, uint32_t outCount, uint32_t batchSize)
+{
+    // Tiles of four rows and two sequences: every weight load is used twice and every input load four times.
+    uint32_t neuronInNextLayer=0;
+    for(;neuronInNextLayer+4<=outCount;neuronInNextLayer+=4)
+    {
+        const double *weightRow0=weights+(size_t)neuronInNextLayer*rowStride;
+        const double *weightRow1=weightRow0+rowStride;
+        const double *weightRow2=weightRow1+rowStride;
+        const double *weightRow3=weightRow2+rowStride;
+        __m256d biasWeights=_mm256_loadu_pd(bias+neuronInNextLayer);
+        uint32_t sequence=0;
+        for(;sequence+2<=batchSize;sequence+=2)
+        {
+            const double *in0=in+(size_t)sequence*rowStride;
+            const double *in1=in0+rowStride;
+            __m256d sum00=_mm256_setzero_pd(),sum10=_mm256_setzero_pd(),sum20=_mm256_setzero_pd(),sum30=_mm256_setzero_pd();
+            __m256d sum01=_mm256_setzero_pd(),sum11=_mm256_setzero_pd(),sum21=_mm256_setzero_pd(),sum31=_mm256_setzero_pd();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=4)
+            {
+                __m256d values0=_mm256_load_pd(in0+neuronInThisLayer);
+                __m256d values1=_mm256_load_pd(in1+neuronInThisLayer);
+                __m256d weight=_mm256_load_pd(weightRow0+neuronInThisLayer);
+                sum00=_mm256_fmadd_pd(weight,values0,sum00);
+                sum01=_mm256_fmadd_pd(weight,values1,sum01);
+                weight=_mm256_load_pd(weightRow1+neuronInThisLayer);
+                sum10=_mm256_fmadd_pd(weight,values0,sum10);
+                sum11=_mm256_fmadd_pd(weight,values1,sum11);
+                weight=_mm256_load_pd(weightRow2+neuronInThisLayer);
+                sum20=_mm256_fmadd_pd(weight,values0,sum20);
+                sum21=_mm256_fmadd_pd(weight,values1,sum21);
+                weight=_mm256_load_pd(weightRow3+neuronInThisLayer);
+                sum30=_mm256_fmadd_pd(weight,values0,sum30);
+                sum31=_mm256_fmadd_pd(weight,values1,sum31);
+            }
+            _mm256_storeu_pd(out+(size_t)sequence*outStride+neuronInNextLayer,_mm256_add_pd(horizontalSumsAVX2(sum00,sum10,sum20,sum30),biasWeights));
+            _mm256_storeu_pd(out+(size_t)(sequence+1)*outStride+neuronInNextLayer,_mm256_add_pd(horizontalSumsAVX2(sum01,sum11,sum21,sum31),biasWeights));
+        }
+        for(;sequence<batchSize;sequence++)
+        {
+            const double *in0=in+(size_t)sequence*rowStride;
+            __m256d sum0=_mm256_setzero_pd(),sum1=_mm256_setzero_pd(),sum2=_mm256_setzero_pd(),sum3=_mm256_setzero_pd();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=4)
+            {
+                __m256d values=_mm256_load_pd(in0+neuronInThisLayer);
+                sum0=_mm256_fmadd_pd(_mm256_load_pd(weightRow0+neuronInThisLayer),values,sum0);
+                sum1=_mm256_fmadd_pd(_mm256_load_pd(weightRow1+neuronInThisLayer),values,sum1);
+                sum2=_mm256_fmadd_pd(_mm256_load_pd(weightRow2+neuronInThisLayer),values,sum2);
+                sum3=_mm256_fmadd_pd(_mm256_load_pd(weightRow3+neuronInThisLayer),values,sum3);
+            }
+            _mm256_storeu_pd(out+(size_t)sequence*outStride+neuronInNextLayer,_mm256_add_pd(horizontalSumsAVX2(sum0,sum1,sum2,sum3),biasWeights));
+        }
+    }
+    for(;neuronInNextLayer<outCount;neuronInNextLayer++)
+    {
+        const double *weightRow=weights+(size_t)neuronInNextLayer*rowStride;
+        for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        {
+            const double *in0=in+(size_t)sequence*rowStride;
+            __m256d sum=_mm256_setzero_pd();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=4)
+                sum=_mm256_fmadd_pd(_mm256_load_pd(weightRow+neuronInThisLayer),_mm256_load_pd(in0+neuronInThisLayer),sum);
+            out[(size_t)sequence*outStride+neuronInNextLayer]=horizontalSumAVX2(sum)+bias[neuronInNextLayer];
+        }
+    }
+}
+
+RNNKERNELS_TARGET_AVX512 void RNNKernels::layerForwardBatchAVX512(const double *weights, uint32_t rowStride, uint32_t paddedInCount, const double *bias, const double *in, double *out, uint32_t outStride, uint32_t outCount, uint32_t batchSize)
+{
+    // Same tiling as the AVX2 kernel, with eight doubles per register (rowStride is a multiple of eight).
+    uint32_t neuronInNextLayer=0;
+    for(;neuronInNextLayer+4<=outCount;neuronInNextLayer+=4)
+    {
+        const double *weightRow0=weights+(size_t)neuronInNextLayer*rowStride;
+        const double *weightRow1=weightRow0+rowStride;
+        const double *weightRow2=weightRow1+rowStride;
+        const double *weightRow3=weightRow2+rowStride;
+        uint32_t sequence=0;
+        for(;sequence+2<=batchSize;sequence+=2)
+        {
+            const double *in0=in+(size_t)sequence*rowStride;
+            const double *in1=in0+rowStride;
+            __m512d sum00=_mm512_setzero_pd(),sum10=_mm512_setzero_pd(),sum20=_mm512_setzero_pd(),sum30=_mm512_setzero_pd();
+            __m512d sum01=_mm512_setzero_pd(),sum11=_mm512_setzero_pd(),sum21=_mm512_setzero_pd(),sum31=_mm512_setzero_pd();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=8)
+            {
+                __m512d values0=_mm512_load_pd(in0+neuronInThisLayer);
+                __m512d values1=_mm512_load_pd(in1+neuronInThisLayer);
+                __m512d weight=_mm512_load_pd(weightRow0+neuronInThisLayer);
+                sum00=_mm512_fmadd_pd(weight,values0,sum00);
+                sum01=_mm512_fmadd_pd(weight,values1,sum01);
+                weight=_mm512_load_pd(weightRow1+neuronInThisLayer);
+                sum10=_mm512_fmadd_pd(weight,values0,sum10);
+                sum11=_mm512_fmadd_pd(weight,values1,sum11);
+                weight=_mm512_load_pd(weightRow2+neuronInThisLayer);
+                sum20=_mm512_fmadd_pd(weight,values0,sum20);
+                sum21=_mm512_fmadd_pd(weight,values1,sum21);
+                weight=_mm512_load_pd(weightRow3+neuronInThisLayer);
+                sum30=_mm512_fmadd_pd(weight,values0,sum30);
+                sum31=_mm512_fmadd_pd(weight,values1,sum31);
+            }
+            double *out0=out+(size_t)sequence*outStride+neuronInNextLayer;
+            double *out1=out0+outStride;
+            out0[0]=horizontalSumAVX512(sum00)+bias[neuronInNextLayer];
+            out0[1]=horizontalSumAVX512(sum10)+bias[neuronInNextLayer+1];
+            out0[2]=horizontalSumAVX512(sum20)+bias[neuronInNextLayer+2];
+            out0[3]=horizontalSumAVX512(sum30)+bias[neuronInNextLayer+3];
+            out1[0]=horizontalSumAVX512(sum01)+bias[neuronInNextLayer];
+            out1[1]=horizontalSumAVX512(sum11)+bias[neuronInNextLayer+1];
+            out1[2]=horizontalSumAVX512(sum21)+bias[neuronInNextLayer+2];
+            out1[3]=horizontalSumAVX512(sum31)+bias[neuronInNextLayer+3];
+        }
+        for(;sequence<batchSize;sequence++)
+        {
+            const double *in0=in+(size_t)sequence*rowStride;
+            __m512d sum0=_mm512_setzero_pd(),sum1=_mm512_setzero_pd(),sum2=_mm512_setzero_pd(),sum3=_mm512_setzero_pd();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=8)
+            {
+                __m512d values=_mm512_load_pd(in0+neuronInThisLayer);
+                sum0=_mm512_fmadd_pd(_mm512_load_pd(weightRow0+neuronInThisLayer),values,sum0);
+                sum1=_mm512_fmadd_pd(_mm512_load_pd(weightRow1+neuronInThisLayer),values,sum1);
+                sum2=_mm512_fmadd_pd(_mm512_load_pd(weightRow2+neuronInThisLayer),values,sum2);
+                sum3=_mm512_fmadd_pd(_mm512_load_pd(weightRow3+neuronInThisLayer),values,sum3);
+            }
+            double *out0=out+(size_t)sequence*outStride+neuronInNextLayer;
+            out0[0]=horizontalSumAVX512(sum0)+bias[neuronInNextLayer];
+            out0[1]=horizontalSumAVX512(sum1)+bias[neuronInNextLayer+1];
+            out0[2]=horizontalSumAVX512(sum2)+bias[neuronInNextLayer+2];
+            out0[3]=horizontalSumAVX512(sum3)+bias[neuronInNextLayer+3];
+        }
+    }
+    for(;neuronInNextLayer<outCount;neuronInNextLayer++)
+    {
+        const double *weightRow=weights+(size_t)neuronInNextLayer*rowStride;
+        for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        {
+            const double *in0=in+(size_t)sequence*rowStride;
+            __m512d sum=_mm512_setzero_pd();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=8)
+                sum=_mm512_fmadd_pd(_mm512_load_pd(weightRow+neuronInThisLayer),_mm512_load_pd(in0+neuronInThisLayer),sum);
+            out[(size_t)sequence*outStride+neuronInNextLayer]=horizontalSumAVX512(sum)+bias[neuronInNextLayer];
+        }
+    }
+}
+
+RNNKERNELS_TARGET_AVX2 static inline float horizontalSumFloatAVX2(__m256 sum)
+{
+    __m128 quarters=_mm_add_ps(_mm256_castps256_ps128(sum),_mm256_extractf128_ps(sum,1));
+    quarters=_mm_add_ps(quarters,_mm_movehl_ps(quarters,quarters));
+    return _mm_cvtss_f32(_mm_add_ss(quarters,_mm_movehdup_ps(quarters)));
+}
+
+RNNKERNELS_TARGET_AVX2 static inline __m128 horizontalSumsFloatAVX2(__m256 sum0, __m256 sum1, __m256 sum2, __m256 sum3)
+{
+    // Reduces four accumulators to one vector holding the four sums.
+    __m256 sums=_mm256_hadd_ps(_mm256_hadd_ps(sum0,sum1),_mm256_hadd_ps(sum2,sum3));
+    return _mm_add_ps(_mm256_castps256_ps128(sums),_mm256_extractf128_ps(sums,1));
+}
+
+RNNKERNELS_TARGET_AVX512 static inline float horizontalSumFloatAVX512(__m512 sum)
+{
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes,sum);
+    float total=0.0f;
+    for(uint32_t lane=0;lane<16;lane+=2)
+        total+=lanes[lane]+lanes[lane+1];
+    return total;
+}
+
+RNNKERNELS_TARGET_AVX2 void RNNKernels::layerForwardBatchAVX2(const float *weights, uint32_t rowStride, uint32_t paddedInCount, const float *bias, const float *in, float *out, uint32_t outStride, uint32_t outCount, uint32_t batchSize)
+{
+    // Same tiling as the double precision kernel, with eight floats per register.
+    uint32_t neuronInNextLayer=0;
+    for(;neuronInNextLayer+4<=outCount;neuronInNextLayer+=4)
+    {
+        const float *weightRow0=weights+(size_t)neuronInNextLayer*rowStride;
+        const float *weightRow1=weightRow0+rowStride;
+        const float *weightRow2=weightRow1+rowStride;
+        const float *weightRow3=weightRow2+rowStride;
+        __m128 biasWeights=_mm_loadu_ps(bias+neuronInNextLayer);
+        uint32_t sequence=0;
+        for(;sequence+2<=batchSize;sequence+=2)
+        {
+            const float *in0=in+(size_t)sequence*rowStride;
+            const float *in1=in0+rowStride;
+            __m256 sum00=_mm256_setzero_ps(),sum10=_mm256_setzero_ps(),sum20=_mm256_setzero_ps(),sum30=_mm256_setzero_ps();
+            __m256 sum01=_mm256_setzero_ps(),sum11=_mm256_setzero_ps(),sum21=_mm256_setzero_ps(),sum31=_mm256_setzero_ps();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=8)
+            {
+                __m256 values0=_mm256_load_ps(in0+neuronInThisLayer);
+                __m256 values1=_mm256_load_ps(in1+neuronInThisLayer);
+                __m256 weight=_mm256_load_ps(weightRow0+neuronInThisLayer);
+                sum00=_mm256_fmadd_ps(weight,values0,sum00);
+                sum01=_mm256_fmadd_ps(weight,values1,sum01);
+                weight=_mm256_load_ps(weightRow1+neuronInThisLayer);
+                sum10=_mm256_fmadd_ps(weight,values0,sum10);
+                sum11=_mm256_fmadd_ps(weight,values1,sum11);
+                weight=_mm256_load_ps(weightRow2+neuronInThisLayer);
+                sum20=_mm256_fmadd_ps(weight,values0,sum20);
+                sum21=_mm256_fmadd_ps(weight,values1,sum21);
+                weight=_mm256_load_ps(weightRow3+neuronInThisLayer);
+                sum30=_mm256_fmadd_ps(weight,values0,sum30);
+                sum31=_mm256_fmadd_ps(weight,values1,sum31);
+            }
+            _mm_storeu_ps(out+(size_t)sequence*outStride+neuronInNextLayer,_mm_add_ps(horizontalSumsFloatAVX2(sum00,sum10,sum20,sum30),biasWeights));
+            _mm_storeu_ps(out+(size_t)(sequence+1)*outStride+neuronInNextLayer,_mm_add_ps(horizontalSumsFloatAVX2(sum01,sum11,sum21,sum31),biasWeights));
+        }
+        for(;sequence<batchSize;sequence++)
+        {
+            const float *in0=in+(size_t)sequence*rowStride;
+            __m256 sum0=_mm256_setzero_ps(),sum1=_mm256_setzero_ps(),sum2=_mm256_setzero_ps(),sum3=_mm256_setzero_ps();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=8)
+            {
+                __m256 values=_mm256_load_ps(in0+neuronInThisLayer);
+                sum0=_mm256_fmadd_ps(_mm256_load_ps(weightRow0+neuronInThisLayer),values,sum0);
+                sum1=_mm256_fmadd_ps(_mm256_load_ps(weightRow1+neuronInThisLayer),values,sum1);
+                sum2=_mm256_fmadd_ps(_mm256_load_ps(weightRow2+neuronInThisLayer),values,sum2);
+                sum3=_mm256_fmadd_ps(_mm256_load_ps(weightRow3+neuronInThisLayer),values,sum3);
+            }
+            _mm_storeu_ps(out+(size_t)sequence*outStride+neuronInNextLayer,_mm_add_ps(horizontalSumsFloatAVX2(sum0,sum1,sum2,sum3),biasWeights));
+        }
+    }
+    for(;neuronInNextLayer<outCount;neuronInNextLayer++)
+    {
+        const float *weightRow=weights+(size_t)neuronInNextLayer*rowStride;
+        for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        {
+            const float *in0=in+(size_t)sequence*rowStride;
+            __m256 sum=_mm256_setzero_ps();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=8)
+                sum=_mm256_fmadd_ps(_mm256_load_ps(weightRow+neuronInThisLayer),_mm256_load_ps(in0+neuronInThisLayer),sum);
+            out[(size_t)sequence*outStride+neuronInNextLayer]=horizontalSumFloatAVX2(sum)+bias[neuronInNextLayer];
+        }
+    }
+}
+
+RNNKERNELS_TARGET_AVX512 void RNNKernels::layerForwardBatchAVX512(const float *weights, uint32_t rowStride, uint32_t paddedInCount, const float *bias, const float *in, float *out, uint32_t outStride, uint32_t outCount, uint32_t batchSize)
+{
+    // Same tiling as the double precision kernel, with sixteen floats per register (rowStride is a multiple of sixteen).
+    uint32_t neuronInNextLayer=0;
+    for(;neuronInNextLayer+4<=outCount;neuronInNextLayer+=4)
+    {
+        const float *weightRow0=weights+(size_t)neuronInNextLayer*rowStride;
+        const float *weightRow1=weightRow0+rowStride;
+        const float *weightRow2=weightRow1+rowStride;
+        const float *weightRow3=weightRow2+rowStride;
+        uint32_t sequence=0;
+        for(;sequence+2<=batchSize;sequence+=2)
+        {
+            const float *in0=in+(size_t)sequence*rowStride;
+            const float *in1=in0+rowStride;
+            __m512 sum00=_mm512_setzero_ps(),sum10=_mm512_setzero_ps(),sum20=_mm512_setzero_ps(),sum30=_mm512_setzero_ps();
+            __m512 sum01=_mm512_setzero_ps(),sum11=_mm512_setzero_ps(),sum21=_mm512_setzero_ps(),sum31=_mm512_setzero_ps();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=16)
+            {
+                __m512 values0=_mm512_load_ps(in0+neuronInThisLayer);
+                __m512 values1=_mm512_load_ps(in1+neuronInThisLayer);
+                __m512 weight=_mm512_load_ps(weightRow0+neuronInThisLayer);
+                sum00=_mm512_fmadd_ps(weight,values0,sum00);
+                sum01=_mm512_fmadd_ps(weight,values1,sum01);
+                weight=_mm512_load_ps(weightRow1+neuronInThisLayer);
+                sum10=_mm512_fmadd_ps(weight,values0,sum10);
+                sum11=_mm512_fmadd_ps(weight,values1,sum11);
+                weight=_mm512_load_ps(weightRow2+neuronInThisLayer);
+                sum20=_mm512_fmadd_ps(weight,values0,sum20);
+                sum21=_mm512_fmadd_ps(weight,values1,sum21);
+                weight=_mm512_load_ps(weightRow3+neuronInThisLayer);
+                sum30=_mm512_fmadd_ps(weight,values0,sum30);
+                sum31=_mm512_fmadd_ps(weight,values1,sum31);
+            }
+            float *out0=out+(size_t)sequence*outStride+neuronInNextLayer;
+            float *out1=out0+outStride;
+            out0[0]=horizontalSumFloatAVX512(sum00)+bias[neuronInNextLayer];
+            out0[1]=horizontalSumFloatAVX512(sum10)+bias[neuronInNextLayer+1];
+            out0[2]=horizontalSumFloatAVX512(sum20)+bias[neuronInNextLayer+2];
+            out0[3]=horizontalSumFloatAVX512(sum30)+bias[neuronInNextLayer+3];
+            out1[0]=horizontalSumFloatAVX512(sum01)+bias[neuronInNextLayer];
+            out1[1]=horizontalSumFloatAVX512(sum11)+bias[neuronInNextLayer+1];
+            out1[2]=horizontalSumFloatAVX512(sum21)+bias[neuronInNextLayer+2];
+            out1[3]=horizontalSumFloatAVX512(sum31)+bias[neuronInNextLayer+3];
+        }
+        for(;sequence<batchSize;sequence++)
+        {
+            const float *in0=in+(size_t)sequence*rowStride;
+            __m512 sum0=_mm512_setzero_ps(),sum1=_mm512_setzero_ps(),sum2=_mm512_setzero_ps(),sum3=_mm512_setzero_ps();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=16)
+            {
+                __m512 values=_mm512_load_ps(in0+neuronInThisLayer);
+                sum0=_mm512_fmadd_ps(_mm512_load_ps(weightRow0+neuronInThisLayer),values,sum0);
+                sum1=_mm512_fmadd_ps(_mm512_load_ps(weightRow1+neuronInThisLayer),values,sum1);
+                sum2=_mm512_fmadd_ps(_mm512_load_ps(weightRow2+neuronInThisLayer),values,sum2);
+                sum3=_mm512_fmadd_ps(_mm512_load_ps(weightRow3+neuronInThisLayer),values,sum3);
+            }
+            float *out0=out+(size_t)sequence*outStride+neuronInNextLayer;
+            out0[0]=horizontalSumFloatAVX512(sum0)+bias[neuronInNextLayer];
+            out0[1]=horizontalSumFloatAVX512(sum1)+bias[neuronInNextLayer+1];
+            out0[2]=horizontalSumFloatAVX512(sum2)+bias[neuronInNextLayer+2];
+            out0[3]=horizontalSumFloatAVX512(sum3)+bias[neuronInNextLayer+3];
+        }
+    }
+    for(;neuronInNextLayer<outCount;neuronInNextLayer++)
+    {
+        const float *weightRow=weights+(size_t)neuronInNextLayer*rowStride;
+        for(uint32_t sequence=0;sequence<batchSize;sequence++)
+        {
+            const float *in0=in+(size_t)sequence*rowStride;
+            __m512 sum=_mm512_setzero_ps();
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<paddedInCount;neuronInThisLayer+=16)
+                sum=_mm512_fmadd_ps(_mm512_load_ps(weightRow+neuronInThisLayer),_mm512_load_ps(in0+neuronInThisLayer),sum);
+            out[(size_t)sequence*outStride+neuronInNextLayer]=horizontalSumFloatAVX512(sum)+bias[neuronInNextLayer];
+        }
+    }
+}
+
+RNNKERNELS_TARGET_AVX2 void RNNKernels::layerForwardQuantizedAVX2(const int8_t *weights, uint32_t rowStride, const rnnfloat_t *rowScales, const rnnfloat_t *bias, const int8_t *in, rnnfloat_t inScale, rnnfloat_t *out, uint32_t outCount)
+{
+    // Sign-extends 16 bytes at a time to 16-bit and uses madd to get eight int32 sums of pairs; |w*x|<=127*127, so nothing can overflow for
+    // rows shorter than 2^17 elements. rowStride is a multiple of 64.
+    for(uint32_t neuronInNextLayer=0;neuronInNextLayer<outCount;neuronInNextLayer++)
+    {
+        const int8_t *weightRow=weights+(size_t)neuronInNextLayer*rowStride;
+        __m256i sum0=_mm256_setzero_si256(),sum1=_mm256_setzero_si256();
+        for(uint32_t neuronInThisLayer=0;neuronInThisLayer<rowStride;neuronInThisLayer+=32)
+        {
+            __m256i weight0=_mm256_cvtepi8_epi16(_mm_load_si128((const __m128i*)(weightRow+neuronInThisLayer)));
+            __m256i weight1=_mm256_cvtepi8_epi16(_mm_load_si128((const __m128i*)(weightRow+neuronInThisLayer+16)));
+            __m256i values0=_mm256_cvtepi8_epi16(_mm_load_si128((const __m128i*)(in+neuronInThisLayer)));
+            __m256i values1=_mm256_cvtepi8_epi16(_mm_load_si128((const __m128i*)(in+neuronInThisLayer+16)));
+            sum0=_mm256_add_epi32(sum0,_mm256_madd_epi16(weight0,values0));
+            sum1=_mm256_add_epi32(sum1,_mm256_madd_epi16(weight1,values1));
+        }
+        __m256i sum=_mm256_add_epi32(sum0,sum1);
+        __m128i halves=_mm_add_epi32(_mm256_castsi256_si128(sum),_mm256_extracti128_si256(sum,1));
+        halves=_mm_add_epi32(halves,_mm_shuffle_epi32(halves,0x4e));
+        halves=_mm_add_epi32(halves,_mm_shuffle_epi32(halves,0xb1));
+        out[neuronInNextLayer]=(rnnfloat_t)_mm_cvtsi128_si32(halves)*rowScales[neuronInNextLayer]*inScale+bias[neuronInNextLayer];
+    }
+}
+
+#endif
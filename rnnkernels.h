@@ -0,0 +1,91 @@
+#ifndef RNNKERNELS_H
+#define RNNKERNELS_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Scalar type of the weights and activations. Defining rnnfloat_t as float (DEFINES += rnnfloat_t=float) halves the memory traffic and doubles
+// the SIMD width; double is the default and serves as the reference. The kernels are available for both types.
+#ifndef rnnfloat_t
+#define rnnfloat_t double
+#endif
+
+#if defined(__x86_64__)||defined(__i386__)||defined(_M_X64)||defined(_M_IX86)
+#define RNNKERNELS_X86
+#ifdef _MSC_VER
+#define RNNKERNELS_TARGET_AVX2
+#define RNNKERNELS_TARGET_AVX512
+#else
+// Allows using the intrinsics in single functions without compiling the whole program for AVX2/AVX-512.
+#define RNNKERNELS_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define RNNKERNELS_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+enum RNNKernelType
+{
+    kernelScalar=0,
+    kernelAVX2=1, // AVX2 + FMA
+    kernelAVX512=2 // AVX-512F
+};
+
+enum RNNActivationType
+{
+    // Maximum absolute errors of tanh() were measured over [-20, 20] against libm's tanh().
+    activationExact=0, // libm; reference results
+    activationFast=1, // exp() via range reduction and a degree 9 polynomial; max. abs. error 4.6e-12
+    activationRational=2, // [7/6] Lambert continued fraction, clamped; max. abs. error 7.1e-5, cheapest
+    activationNone=3 // No activation function (the sums are passed on as they are); used before a softmax
+};
+
+enum RNNOutputType
+{
+    outputTanh=0, // tanh() like the other layers; the error is desired-output (squared error)
+    outputSoftmax=1 // Softmax over all outputs with a cross-entropy loss; the outputs are probabilities
+};
+
+// Compute kernels for a single layer transition. All kernel types produce the same results up to floating-point rounding (the vectorized
+// kernels sum in a different order).
+//
+// Requirements for "weights" and "in" (both are met by RNNWeights and RNNState):
+// - Both are ALIGNEDMEMORY_ALIGNMENT-byte-aligned.
+// - Weight rows (and the input vectors of a batch) are "rowStride" elements apart. The vectorized kernels run over "inCount" rounded up to
+//   ALIGNEDMEMORY_ALIGNMENT bytes, so the elements from "inCount" up to there must be zeroes in both. "rowStride" is usually that rounded
+//   count; a larger one allows computing a part of each row that starts at an aligned column (see RNN::processSparseBatch()).
+
+class RNNKernels
+{
+public:
+    static RNNKernelType detectBestKernelType();
+    static bool isKernelTypeSupported(RNNKernelType kernelType);
+    static const char *getKernelTypeName(RNNKernelType kernelType);
+
+    // out[neuronInNextLayer]=activation(sum(weights[neuronInNextLayer][neuronInThisLayer]*in[neuronInThisLayer])+bias[neuronInNextLayer]), where
+    // activation() is tanh() computed as selected by "activationType" (see RNNActivation::tanhArray()), or the identity for activationNone
+    static void layerForward(RNNKernelType kernelType,RNNActivationType activationType,const double *weights,uint32_t rowStride,const double *bias,const double *in,uint32_t inCount,double *out,uint32_t outCount);
+    // Same as layerForward() for "batchSize" input vectors at once (a matrix-matrix product); every weight row is loaded once per tile of
+    // sequences instead of once per sequence. The input vectors are "rowStride" elements apart, the output vectors "outStride" elements.
+    static void layerForwardBatch(RNNKernelType kernelType,RNNActivationType activationType,const double *weights,uint32_t rowStride,const double *bias,const double *in,uint32_t inCount,double *out,uint32_t outStride,uint32_t outCount,uint32_t batchSize);
+
+    static void layerForward(RNNKernelType kernelType,RNNActivationType activationType,const float *weights,uint32_t rowStride,const float *bias,const float *in,uint32_t inCount,float *out,uint32_t outCount);
+    static void layerForwardBatch(RNNKernelType kernelType,RNNActivationType activationType,const float *weights,uint32_t rowStride,const float *bias,const float *in,uint32_t inCount,float *out,uint32_t outStride,uint32_t outCount,uint32_t batchSize);
+
+    // Quantized version (see QuantizedRNN): out[neuronInNextLayer]=activation(sum(weights*in)*rowScales[neuronInNextLayer]*inScale+bias[neuronInNextLayer]),
+    // with int8 weights and inputs and int32 sums. Rows are "rowStride" bytes long; the same requirements as above apply.
+    static void layerForwardQuantized(RNNKernelType kernelType,RNNActivationType activationType,const int8_t *weights,uint32_t rowStride,const rnnfloat_t *rowScales,const rnnfloat_t *bias,const int8_t *in,rnnfloat_t inScale,uint32_t inCount,rnnfloat_t *out,uint32_t outCount);
+    static rnnfloat_t quantizeValues(const rnnfloat_t *in,int8_t *out,uint32_t count); // Symmetric: in[i]~=out[i]*(returned scale)
+
+private:
+    static void layerForwardBatchScalar(const double *weights,uint32_t rowStride,const double *bias,const double *in,uint32_t inCount,double *out,uint32_t outStride,uint32_t outCount,uint32_t batchSize);
+    static void layerForwardBatchScalar(const float *weights,uint32_t rowStride,const float *bias,const float *in,uint32_t inCount,float *out,uint32_t outStride,uint32_t outCount,uint32_t batchSize);
+    static void layerForwardQuantizedScalar(const int8_t *weights,uint32_t rowStride,const rnnfloat_t *rowScales,const rnnfloat_t *bias,const int8_t *in,rnnfloat_t inScale,uint32_t inCount,rnnfloat_t *out,uint32_t outCount);
+#ifdef RNNKERNELS_X86
+    static void layerForwardBatchAVX2(const double *weights,uint32_t rowStride,uint32_t paddedInCount,const double *bias,const double *in,double *out,uint32_t outStride,uint32_t outCount,uint32_t batchSize);
+    static void layerForwardBatchAVX512(const double *weights,uint32_t rowStride,uint32_t paddedInCount,const double *bias,const double *in,double *out,uint32_t outStride,uint32_t outCount,uint32_t batchSize);
+    static void layerForwardBatchAVX2(const float *weights,uint32_t rowStride,uint32_t paddedInCount,const float *bias,const float *in,float *out,uint32_t outStride,uint32_t outCount,uint32_t batchSize);
+    static void layerForwardBatchAVX512(const float *weights,uint32_t rowStride,uint32_t paddedInCount,const float *bias,const float *in,float *out,uint32_t outStride,uint32_t outCount,uint32_t batchSize);
+    static void layerForwardQuantizedAVX2(const int8_t *weights,uint32_t rowStride,const rnnfloat_t *rowScales,const rnnfloat_t *bias,const int8_t *in,rnnfloat_t inScale,rnnfloat_t *out,uint32_t outCount);
+#endif
+};
+
+#endif // RNNKERNELS_H
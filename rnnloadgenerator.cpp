@@ -0,0 +1,243 @@
+// Load generator for the inference server (see RNNServer); usage:
+// rnnloadgenerator <socket path> [connections] [sessions per connection] [requests per session] [symbols per generation (0: steps only)]
+// Every connection steps its sessions with random symbols in rounds: one pipelined request per session, then all responses. With a symbol
+// count, every request after the first one of a session is a generation request. The latencies are measured on the client side.
+
+#include <stdlib.h>
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "io.h"
+#include "text.h"
+
+#include "rnnserverprotocol.h"
+
+using namespace std;
+
+struct LoadGeneratorConnection
+{
+    const char *socketPath;
+    uint32_t connectionIndex;
+    uint32_t sessionCount;
+    uint32_t requestsPerSession;
+    uint32_t generationSymbolCount;
+    uint32_t symbolCount; // Of the model
+
+    // Results
+    vector<double> latencies; // Microseconds
+    uint64_t errorCount;
+    uint64_t generatedSymbolCount;
+};
+
+static double getTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int connectToServer(const char *socketPath)
+{
+    sockaddr_un address;
+    memset(&address,0,sizeof(address));
+    address.sun_family=AF_UNIX;
+    if(strlen(socketPath)>=sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path,socketPath);
+    int connectionSocket=socket(AF_UNIX,SOCK_STREAM,0);
+    if(connectionSocket<0)
+        return -1;
+    if(connect(connectionSocket,(sockaddr*)&address,sizeof(address))!=0)
+    {
+        close(connectionSocket);
+        return -1;
+    }
+    return connectionSocket;
+}
+
+static void runConnection(LoadGeneratorConnection *connection)
+{
+    connection->errorCount=0;
+    connection->generatedSymbolCount=0;
+    int connectionSocket=connectToServer(connection->socketPath);
+    if(connectionSocket<0)
+    {
+        connection->errorCount=(uint64_t)connection->sessionCount*connection->requestsPerSession;
+        return;
+    }
+    uint64_t randomState=0x9e3779b97f4a7c15ULL*(connection->connectionIndex+1); // xorshift64*
+    fs_t bufferSize=1024;
+    char *buffer=(char*)malloc(bufferSize);
+    fs_t receiveBufferSize=1024;
+    char *receiveBuffer=(char*)malloc(receiveBufferSize);
+    char sessionName[64];
+    double temperature=0.8;
+    double topP=0.95;
+    bool failed=false;
+    for(uint32_t round=0;round<connection->requestsPerSession&&!failed;round++)
+    {
+        // One frame per session, sent with one write
+        fs_t pos=0;
+        for(uint32_t session=0;session<connection->sessionCount;session++)
+        {
+            snprintf(sessionName,sizeof(sessionName),"c%u-s%u",connection->connectionIndex,session);
+            fs_t frameStart=pos;
+            io::writeUInt32ToBuffer(buffer,0,pos,bufferSize); // Payload length, see below
+            if(round==0||connection->generationSymbolCount==0)
+            {
+                RNNServerProtocol::writeRequestHeader(buffer,pos,bufferSize,requestStepSymbol,session,sessionName);
+                randomState^=randomState>>12;
+                randomState^=randomState<<25;
+                randomState^=randomState>>27;
+                io::writeUInt32ToBuffer(buffer,(uint32_t)(((randomState*0x2545f4914f6cdd1dULL)>>32)%connection->symbolCount),pos,bufferSize);
+            }
+            else
+            {
+                RNNServerProtocol::writeRequestHeader(buffer,pos,bufferSize,requestGenerate,session,sessionName);
+                io::writeUInt32ToBuffer(buffer,connection->generationSymbolCount,pos,bufferSize);
+                io::writeDoubleArrayToBuffer(buffer,&temperature,1,pos,bufferSize);
+                io::writeUInt32ToBuffer(buffer,0,pos,bufferSize); // topK
+                io::writeDoubleArrayToBuffer(buffer,&topP,1,pos,bufferSize);
+            }
+            RNNServerProtocol::endFrame(buffer+frameStart,pos-frameStart);
+        }
+        double sendTime=getTime();
+        if(!RNNServerProtocol::writeAll(connectionSocket,buffer,pos))
+            break;
+
+        for(uint32_t i=0;i<connection->sessionCount;i++)
+        {
+            fs_t length;
+            if(!RNNServerProtocol::readFrame(connectionSocket,receiveBuffer,receiveBufferSize,length)||
+                    !RNNServerProtocol::canRead(receiveBuffer,receiveBuffer+length,sizeof(uint32_t)+sizeof(uint8_t)))
+            {
+                failed=true;
+                break;
+            }
+            char *data=receiveBuffer;
+            uint32_t requestId=io::readUInt32(data);
+            uint8_t status=io::readUInt8(data);
+            if(requestId>=connection->sessionCount||status!=statusOk)
+            {
+                connection->errorCount++;
+                continue;
+            }
+            connection->latencies.push_back((getTime()-sendTime)*1e6);
+            if(round>0&&connection->generationSymbolCount>0)
+                connection->generatedSymbolCount+=connection->generationSymbolCount;
+        }
+    }
+    if(failed)
+        connection->errorCount++;
+    free(buffer);
+    free(receiveBuffer);
+    close(connectionSocket);
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc<2)
+    {
+        cerr<<"Usage: "<<argv[0]<<" <socket path> [connections] [sessions per connection] [requests per session] [symbols per generation (0: steps only)]"<<endl;
+        return 1;
+    }
+    const char *socketPath=argv[1];
+    uint32_t connectionCount=argc>2?(uint32_t)atoi(argv[2]):4;
+    uint32_t sessionCount=argc>3?(uint32_t)atoi(argv[3]):16;
+    uint32_t requestsPerSession=argc>4?(uint32_t)atoi(argv[4]):200;
+    uint32_t generationSymbolCount=argc>5?(uint32_t)atoi(argv[5]):0;
+    if(connectionCount==0||sessionCount==0||requestsPerSession==0)
+        return 1;
+
+    // The model's dimensions
+    int infoSocket=connectToServer(socketPath);
+    if(infoSocket<0)
+    {
+        cerr<<"Couldn't connect to "<<socketPath<<endl;
+        return 1;
+    }
+    fs_t bufferSize=256;
+    char *buffer=(char*)malloc(bufferSize);
+    fs_t pos;
+    RNNServerProtocol::beginFrame(buffer,pos,bufferSize);
+    RNNServerProtocol::writeRequestHeader(buffer,pos,bufferSize,requestInfo,0,"");
+    RNNServerProtocol::endFrame(buffer,pos);
+    fs_t length;
+    uint32_t symbolCount=0;
+    if(RNNServerProtocol::writeAll(infoSocket,buffer,pos)&&RNNServerProtocol::readFrame(infoSocket,buffer,bufferSize,length)&&
+            RNNServerProtocol::canRead(buffer,buffer+length,sizeof(uint32_t)+sizeof(uint8_t)+3*sizeof(uint32_t)))
+    {
+        char *data=buffer;
+        io::readUInt32(data); // Request ID
+        uint8_t status=io::readUInt8(data);
+        uint32_t inputCount=io::readUInt32(data);
+        uint32_t outputCount=io::readUInt32(data);
+        symbolCount=io::readUInt32(data);
+        if(status==statusOk)
+            cout<<"Model inputs: "<<inputCount<<", outputs: "<<outputCount<<endl;
+        else
+            symbolCount=0;
+    }
+    free(buffer);
+    close(infoSocket);
+    if(symbolCount==0)
+    {
+        cerr<<"No model information received"<<endl;
+        return 1;
+    }
+
+    vector<LoadGeneratorConnection> connections(connectionCount);
+    vector<thread*> threads;
+    double startTime=getTime();
+    for(uint32_t i=0;i<connectionCount;i++)
+    {
+        LoadGeneratorConnection &connection=connections[i];
+        connection.socketPath=socketPath;
+        connection.connectionIndex=i;
+        connection.sessionCount=sessionCount;
+        connection.requestsPerSession=requestsPerSession;
+        connection.generationSymbolCount=generationSymbolCount;
+        connection.symbolCount=symbolCount;
+        threads.push_back(new thread(runConnection,&connection));
+    }
+    for(uint32_t i=0;i<connectionCount;i++)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+    double seconds=getTime()-startTime;
+
+    vector<double> latencies;
+    uint64_t errorCount=0;
+    uint64_t generatedSymbolCount=0;
+    for(uint32_t i=0;i<connectionCount;i++)
+    {
+        latencies.insert(latencies.end(),connections[i].latencies.begin(),connections[i].latencies.end());
+        errorCount+=connections[i].errorCount;
+        generatedSymbolCount+=connections[i].generatedSymbolCount;
+    }
+    uint64_t requestCount=latencies.size();
+    char *str=text::doubleToStringWithFixedPrecision((double)requestCount/seconds,0);
+    cout<<"Requests: "<<requestCount<<" ("<<errorCount<<" failed) in "<<seconds<<" s, throughput: "<<str<<" requests/s";
+    free(str);
+    if(generatedSymbolCount>0)
+    {
+        str=text::doubleToStringWithFixedPrecision((double)generatedSymbolCount/seconds,0);
+        cout<<", "<<str<<" generated symbols/s";
+        free(str);
+    }
+    str=text::doubleToStringWithFixedPrecision(RNNServerProtocol::getPercentile(latencies,0.5),0);
+    cout<<", latency p50: "<<str<<" us";
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(RNNServerProtocol::getPercentile(latencies,0.99),0);
+    cout<<", p99: "<<str<<" us"<<endl;
+    free(str);
+    return errorCount>0?1:0;
+}
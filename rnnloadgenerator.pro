@@ -0,0 +1,21 @@
+QT += core
+QT -= gui
+
+TARGET = rnnloadgenerator
+CONFIG += console c++11 thread
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+# Load generator for the local inference server (see rnnloadgenerator.cpp); POSIX only
+OBJECTS_DIR = rnnloadgenerator-objects
+
+SOURCES += rnnloadgenerator.cpp \
+    io.cpp \
+    text.cpp \
+    rnnserverprotocol.cpp
+
+HEADERS += \
+    io.h \
+    text.h \
+    rnnserverprotocol.h
@@ -0,0 +1,132 @@
+#include "rnnmodelfile.h"
+
+RNNModelFile::RNNModelFile()
+{
+    weights=0;
+    layerNeuronCounts=0;
+    layerCount=0;
+    inputCount=0;
+    outputCount=0;
+    activationType=activationFast;
+    outputType=outputTanh;
+}
+
+RNNModelFile::~RNNModelFile()
+{
+    close();
+}
+
+bool RNNModelFile::save(RNN *rnn, const char *fileName)
+{
+    fs_t bufferSize=RNNMODELFILE_HEADER_SIZE*2;
+    char *buffer=(char*)malloc(bufferSize);
+    fs_t pos=0;
+    io::writeRawDataToBuffer(buffer,RNNMODELFILE_MAGIC,8,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,RNNMODELFILE_VERSION,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,sizeof(rnnfloat_t),pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->inputCount,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->outputCount,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->layerCount,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->activationType,pos,bufferSize);
+    uint64_t parameterOffset=RNNMODELFILE_HEADER_SIZE+(uint64_t)rnn->layerCount*sizeof(uint32_t);
+    parameterOffset=(parameterOffset+ALIGNEDMEMORY_ALIGNMENT-1)/ALIGNEDMEMORY_ALIGNMENT*ALIGNEDMEMORY_ALIGNMENT;
+    io::writeUInt64ToBuffer(buffer,parameterOffset,pos,bufferSize);
+    io::writeUInt64ToBuffer(buffer,rnn->weights->parameterCount,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,rnn->outputType,pos,bufferSize);
+    while(pos<RNNMODELFILE_HEADER_SIZE)
+        io::writeUInt8ToBuffer(buffer,0,pos,bufferSize);
+    for(uint32_t thisLayer=0;thisLayer<rnn->layerCount;thisLayer++)
+        io::writeUInt32ToBuffer(buffer,rnn->layerNeuronCounts[thisLayer],pos,bufferSize);
+    while(pos<parameterOffset)
+        io::writeUInt8ToBuffer(buffer,0,pos,bufferSize);
+
+    FILE *outputFile=fopen(fileName,"wb");
+    if(outputFile==0)
+    {
+        free(buffer);
+        return false;
+    }
+    bool ok=(fwrite(buffer,1,pos,outputFile)==pos);
+    free(buffer);
+    char *chunk=(char*)malloc(RNNCHECKPOINT_CHUNK_SIZE);
+    ok=ok&&RNNCheckpoint::writeValues(outputFile,rnn->weights->parameters,rnn->weights->parameterCount,chunk);
+    free(chunk);
+    if(fclose(outputFile)!=0)
+        ok=false;
+    return ok;
+}
+
+bool RNNModelFile::open(const char *fileName)
+{
+    close();
+#ifdef IO_BIG_ENDIAN
+    return false;
+#endif
+    if(!file.open(fileName))
+        return false;
+    if(file.size<RNNMODELFILE_HEADER_SIZE||memcmp(file.data,RNNMODELFILE_MAGIC,8)!=0)
+    {
+        close();
+        return false;
+    }
+    char *data=(char*)file.data+8;
+    uint32_t version=io::readUInt32(data);
+    uint32_t valueSize=io::readUInt32(data);
+    inputCount=io::readUInt32(data);
+    outputCount=io::readUInt32(data);
+    layerCount=io::readUInt32(data);
+    activationType=(RNNActivationType)io::readUInt32(data);
+    uint64_t parameterOffset=io::readUInt64(data);
+    uint64_t parameterCount=io::readUInt64(data);
+    outputType=(RNNOutputType)io::readUInt32(data);
+    if(activationType>activationNone||outputType>outputSoftmax||version!=RNNMODELFILE_VERSION||valueSize!=sizeof(rnnfloat_t)||layerCount<2||parameterOffset%ALIGNEDMEMORY_ALIGNMENT!=0||
+       parameterOffset<RNNMODELFILE_HEADER_SIZE+(uint64_t)layerCount*sizeof(uint32_t)||parameterOffset>file.size||
+       parameterCount>(file.size-parameterOffset)/sizeof(rnnfloat_t))
+    {
+        close();
+        return false;
+    }
+
+    data=(char*)file.data+RNNMODELFILE_HEADER_SIZE;
+    layerNeuronCounts=(uint32_t*)malloc(layerCount*sizeof(uint32_t));
+    for(uint32_t thisLayer=0;thisLayer<layerCount;thisLayer++)
+        layerNeuronCounts[thisLayer]=io::readUInt32(data);
+    // The layer sizes are checked before the view is built: the states hold outputCount values of the last layer, and the padded sizes of
+    // huge layers would overflow.
+    bool ok=((uint64_t)layerNeuronCounts[0]==(uint64_t)inputCount+outputCount&&layerNeuronCounts[layerCount-1]==outputCount);
+    for(uint32_t thisLayer=0;thisLayer<layerCount&&ok;thisLayer++)
+        ok=(layerNeuronCounts[thisLayer]>0&&layerNeuronCounts[thisLayer]<=RNNMODELFILE_MAX_LAYER_SIZE);
+    if(!ok)
+    {
+        close();
+        return false;
+    }
+    // The mapping is read-only; the view must not be written to (RNNWeights::readOnly makes learning throw).
+    weights=new RNNWeights(layerCount,layerNeuronCounts,(rnnfloat_t*)(file.data+parameterOffset),true);
+    if(weights->parameterCount!=parameterCount)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void RNNModelFile::close()
+{
+    delete weights;
+    weights=0;
+    free(layerNeuronCounts);
+    layerNeuronCounts=0;
+    file.close();
+}
+
+RNN *RNNModelFile::createRNN(uint32_t batchSize)
+{
+    if(weights==0)
+        throw;
+    RNN *rnn=new RNN(inputCount,outputCount,0 /*No history*/,0.0,0.0,0.0,layerCount,layerNeuronCounts,batchSize,weights);
+    rnn->activationType=activationType;
+    rnn->outputType=outputType;
+    rnn->setInferenceOnly();
+    return rnn;
+}
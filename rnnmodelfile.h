@@ -0,0 +1,58 @@
+#ifndef RNNMODELFILE_H
+#define RNNMODELFILE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "io.h"
+#include "mappedfile.h"
+#include "rnn.h"
+#include "rnncheckpoint.h"
+
+#define RNNMODELFILE_MAGIC "RNNMODEL" // 8 bytes, not terminated in the file
+#define RNNMODELFILE_VERSION 1
+#define RNNMODELFILE_HEADER_SIZE 64
+#define RNNMODELFILE_MAX_LAYER_SIZE RNNCHECKPOINT_MAX_LAYER_SIZE // Neurons; files with larger layers are rejected as corrupt.
+
+// Inference model file that is used in place: the file is mapped read-only and its parameter section serves directly as the weights of
+// RNNs, so opening it takes constant time regardless of the model size, and all processes that open the same file share the same physical
+// pages. Unlike RNNCheckpoint, it has no momentum terms, hyperparameters or history. Layout (all numbers little-endian):
+//
+//   Offset 0, fixed header (RNNMODELFILE_HEADER_SIZE bytes, zero-padded): magic (8 bytes), version, sizeof(rnnfloat_t), inputCount,
+//           outputCount, layerCount, activationType (uint32 each), parameter section offset, parameter count (uint64 each), outputType
+//           (uint32; files written before it was added have zero padding there, i.e. outputTanh)
+//   Offset RNNMODELFILE_HEADER_SIZE: layerNeuronCounts (uint32 each)
+//   Parameter section offset (a multiple of ALIGNEDMEMORY_ALIGNMENT): the parameters as IEEE-754 rnnfloat_t values, in the layout of
+//           RNNWeights::parameters (including the zero padding)
+//
+// Since the values are used without conversion, big-endian hosts cannot open model files.
+
+class RNNModelFile
+{
+public:
+    MappedFile file;
+    RNNWeights *weights; // Read-only view of the mapped parameters; 0 if no file is open
+
+    uint32_t *layerNeuronCounts;
+    uint32_t layerCount;
+    uint32_t inputCount;
+    uint32_t outputCount;
+    RNNActivationType activationType;
+    RNNOutputType outputType;
+
+
+    static bool save(RNN *rnn,const char *fileName); // False if the file couldn't be written
+
+    bool open(const char *fileName); // False if the file couldn't be mapped or isn't a compatible model file
+    void close(); // RNNs created by createRNN() must be deleted first.
+
+    // Inference-only RNN that uses the mapped weights (no history; learning throws). It must be deleted before the model file is closed.
+    RNN *createRNN(uint32_t batchSize=1);
+
+    RNNModelFile();
+    ~RNNModelFile();
+};
+
+#endif // RNNMODELFILE_H
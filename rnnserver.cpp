@@ -0,0 +1,627 @@
+#include "rnnserver.h"
+
+#include <chrono>
+#include <cmath>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+std::string RNNServerReport::toString()
+{
+    std::string out;
+    char *str=text::unsignedLongToString(requestCount);
+    out+="Requests: ";
+    out+=str;
+    free(str);
+    str=text::unsignedLongToString(stepCount);
+    out+=", steps: ";
+    out+=str;
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(meanBatchSize,1);
+    out+=", mean batch size: ";
+    out+=str;
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(requestsPerSecond,0);
+    out+=", throughput: ";
+    out+=str;
+    out+=" requests/s";
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(stepsPerSecond,0);
+    out+=", ";
+    out+=str;
+    out+=" steps/s";
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(p50LatencyMicroseconds,0);
+    out+=", latency p50: ";
+    out+=str;
+    out+=" us";
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(p99LatencyMicroseconds,0);
+    out+=", p99: ";
+    out+=str;
+    out+=" us";
+    free(str);
+    return out;
+}
+
+RNNServerConnection::RNNServerConnection(RNNServer *_server, int _socket)
+{
+    server=_server;
+    socket=_socket;
+    readerThread=0;
+    writerThread=0;
+    outboundBufferSize=1024;
+    outboundData=(char*)malloc(outboundBufferSize);
+    outboundLength=0;
+    pendingRequestCount=0;
+    isReaderDone=false;
+    isWriterDone=false;
+    isBroken=false;
+}
+
+RNNServerConnection::~RNNServerConnection()
+{
+    free(outboundData);
+}
+
+RNNServer::RNNServer(RNN *_model, uint32_t _maxBatchSize, double _batchWindowSeconds)
+{
+    model=_model;
+    maxBatchSize=_maxBatchSize;
+    batchWindowSeconds=_batchWindowSeconds;
+    if(maxBatchSize==0)
+        throw;
+    executor=new RNN(model->inputCount,model->outputCount,0 /*No history*/,0.0,0.0,0.0,model->layerCount,model->layerNeuronCounts,maxBatchSize,model->weights);
+    executor->kernelType=model->kernelType;
+    executor->activationType=model->activationType;
+    executor->outputType=model->outputType;
+    executor->threadTeam=model->threadTeam;
+    executor->setInferenceOnly();
+    sampler=new RNNGenerator(model);
+
+    listenSocket=-1;
+    acceptThread=0;
+    batchThread=0;
+    stopping=false;
+    hasFinishedConnections=false;
+    responseBufferSize=1024;
+    responseBuffer=(char*)malloc(responseBufferSize);
+    requestCount=0;
+    stepCount=0;
+    batchCount=0;
+    intervalStartTime=getTime();
+}
+
+RNNServer::~RNNServer()
+{
+    stop();
+    delete executor;
+    delete sampler;
+    free(responseBuffer);
+}
+
+bool RNNServer::start(const char *socketPath)
+{
+    stop();
+    sockaddr_un address;
+    memset(&address,0,sizeof(address));
+    address.sun_family=AF_UNIX;
+    if(strlen(socketPath)>=sizeof(address.sun_path))
+        return false;
+    strcpy(address.sun_path,socketPath);
+    listenSocket=socket(AF_UNIX,SOCK_STREAM,0);
+    if(listenSocket<0)
+        return false;
+    unlink(socketPath);
+    if(bind(listenSocket,(sockaddr*)&address,sizeof(address))!=0||listen(listenSocket,128)!=0)
+    {
+        close(listenSocket);
+        listenSocket=-1;
+        return false;
+    }
+    socketFileName=socketPath;
+
+    stopping=false;
+    intervalStartTime=getTime();
+    batchThread=new std::thread(&RNNServer::batchLoop,this);
+    acceptThread=new std::thread(&RNNServer::acceptLoop,this);
+    return true;
+}
+
+void RNNServer::stop()
+{
+    if(listenSocket<0)
+        return;
+    stopping=true;
+    shutdown(listenSocket,SHUT_RDWR); // Wakes up accept().
+    acceptThread->join();
+    delete acceptThread;
+    acceptThread=0;
+    close(listenSocket);
+    listenSocket=-1;
+    unlink(socketFileName.c_str());
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+    }
+    queueCondition.notify_all();
+    batchThread->join();
+    delete batchThread;
+    batchThread=0;
+
+    // The readers end when their sockets are shut down, the writers when their connections are marked as broken.
+    for(size_t i=0;i<connections.size();i++)
+    {
+        RNNServerConnection *connection=connections[i];
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            connection->isBroken=true;
+        }
+        connection->writerCondition.notify_one();
+        shutdown(connection->socket,SHUT_RDWR);
+        connection->readerThread->join();
+        delete connection->readerThread;
+        connection->writerThread->join();
+        delete connection->writerThread;
+        close(connection->socket);
+        delete connection;
+    }
+    connections.clear();
+    hasFinishedConnections=false;
+    for(size_t i=0;i<queuedRequests.size();i++)
+        delete queuedRequests[i];
+    queuedRequests.clear();
+    for(size_t i=0;i<activeGenerations.size();i++)
+        delete activeGenerations[i];
+    activeGenerations.clear();
+    for(std::unordered_map<std::string,RNNSession*>::iterator it=sessions.begin();it!=sessions.end();++it)
+        delete it->second;
+    sessions.clear();
+}
+
+RNNServerReport RNNServer::getReport(bool reset)
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    RNNServerReport report;
+    report.requestCount=requestCount;
+    report.stepCount=stepCount;
+    report.batchCount=batchCount;
+    report.meanBatchSize=batchCount>0?(double)stepCount/(double)batchCount:0.0;
+    report.seconds=getTime()-intervalStartTime;
+    report.requestsPerSecond=report.seconds>0.0?(double)requestCount/report.seconds:0.0;
+    report.stepsPerSecond=report.seconds>0.0?(double)stepCount/report.seconds:0.0;
+    report.p50LatencyMicroseconds=RNNServerProtocol::getPercentile(latencies,0.5);
+    report.p99LatencyMicroseconds=RNNServerProtocol::getPercentile(latencies,0.99);
+    if(reset)
+    {
+        requestCount=0;
+        stepCount=0;
+        batchCount=0;
+        latencies.clear();
+        intervalStartTime=getTime();
+    }
+    return report;
+}
+
+double RNNServer::getTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void RNNServer::acceptLoop()
+{
+    while(!stopping)
+    {
+        int connectionSocket=accept(listenSocket,0,0);
+        if(connectionSocket<0)
+        {
+            if(stopping)
+                return;
+            if(errno==EINTR||errno==ECONNABORTED)
+                continue;
+            if(errno==EMFILE||errno==ENFILE||errno==ENOBUFS||errno==ENOMEM)
+            {
+                // Out of descriptors or memory: waits for finished connections to be released instead of giving up.
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            return; // Failed
+        }
+        // A send that makes no progress for this long fails, so the writer gives up on clients that don't read.
+        timeval sendTimeout;
+        sendTimeout.tv_sec=RNNSERVER_SEND_TIMEOUT_SECONDS;
+        sendTimeout.tv_usec=0;
+        setsockopt(connectionSocket,SOL_SOCKET,SO_SNDTIMEO,&sendTimeout,sizeof(sendTimeout));
+        RNNServerConnection *connection=new RNNServerConnection(this,connectionSocket);
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        connections.push_back(connection);
+        connection->readerThread=new std::thread(&RNNServer::connectionLoop,this,connection);
+        connection->writerThread=new std::thread(&RNNServer::writerLoop,this,connection);
+    }
+}
+
+void RNNServer::connectionLoop(RNNServerConnection *connection)
+{
+    fs_t bufferSize=1024;
+    char *buffer=(char*)malloc(bufferSize);
+    fs_t directResponseBufferSize=64; // Info and error responses are sent by this thread.
+    char *directResponseBuffer=(char*)malloc(directResponseBufferSize);
+    const uint32_t maxGenerationLength=RNNSERVERPROTOCOL_MAX_FRAME_SIZE/sizeof(uint32_t)-4; // The response must fit into a frame.
+    fs_t length;
+    while(!stopping&&RNNServerProtocol::readFrame(connection->socket,buffer,bufferSize,length))
+    {
+        RNNServerRequest *request=parseRequest(connection,buffer,length);
+        if(request==0)
+            break; // Malformed framing; the connection is not usable anymore.
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            connection->pendingRequestCount++; // Until respond()
+        }
+        bool isValid=(request->type<=requestEndSession);
+        if(request->type==requestStepSymbol)
+            isValid=(request->symbol<model->inputCount);
+        else if(request->type==requestStep)
+        {
+            // Non-finite inputs would end up in the session's output and break the sampling of later generation requests.
+            isValid=(request->input.size()==model->inputCount);
+            for(size_t i=0;i<request->input.size()&&isValid;i++)
+                isValid=std::isfinite(request->input[i]);
+        }
+        else if(request->type==requestGenerate)
+            isValid=(request->symbolCount>0&&request->symbolCount<=maxGenerationLength&&std::isfinite(request->temperature)&&
+                     std::isfinite(request->topP)&&request->topP>0.0&&request->topP<=1.0);
+        if(!isValid)
+            respond(request,statusBadRequest,directResponseBuffer,directResponseBufferSize);
+        else if(request->type==requestInfo)
+            respond(request,statusOk,directResponseBuffer,directResponseBufferSize);
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                queuedRequests.push_back(request);
+            }
+            queueCondition.notify_all();
+        }
+    }
+    free(buffer);
+    free(directResponseBuffer);
+    // The writer shuts the socket down once the remaining responses are sent, so the client sees the end after them.
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->isReaderDone=true;
+    }
+    connection->writerCondition.notify_one();
+    notifyConnectionFinished();
+}
+
+void RNNServer::writerLoop(RNNServerConnection *connection)
+{
+    // Sends everything that was queued since the last send at once, so pipelined responses share a write.
+    fs_t bufferSize=1024;
+    char *buffer=(char*)malloc(bufferSize);
+    std::unique_lock<std::mutex> lock(connection->mutex);
+    while(true)
+    {
+        while(!connection->isBroken&&connection->outboundLength==0&&!(connection->isReaderDone&&connection->pendingRequestCount==0))
+            connection->writerCondition.wait(lock);
+        if(connection->isBroken||connection->outboundLength==0)
+            break;
+        std::swap(buffer,connection->outboundData);
+        std::swap(bufferSize,connection->outboundBufferSize);
+        fs_t length=connection->outboundLength;
+        connection->outboundLength=0;
+        lock.unlock();
+        bool ok=RNNServerProtocol::writeAll(connection->socket,buffer,length); // Fails when the client is gone or times out.
+        lock.lock();
+        if(!ok)
+            connection->isBroken=true;
+    }
+    // Later responses are dropped.
+    connection->isBroken=true;
+    connection->outboundLength=0;
+    connection->isWriterDone=true;
+    lock.unlock();
+    shutdown(connection->socket,SHUT_RDWR); // Also ends the reader; the socket is closed by releaseFinishedConnections().
+    free(buffer);
+    notifyConnectionFinished();
+}
+
+void RNNServer::notifyConnectionFinished()
+{
+    hasFinishedConnections=true;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+    }
+    queueCondition.notify_all();
+}
+
+void RNNServer::releaseFinishedConnections()
+{
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    size_t keptCount=0;
+    for(size_t i=0;i<connections.size();i++)
+    {
+        RNNServerConnection *connection=connections[i];
+        bool isFinished;
+        {
+            std::lock_guard<std::mutex> connectionLock(connection->mutex);
+            isFinished=connection->isFinished();
+        }
+        if(!isFinished)
+        {
+            connections[keptCount++]=connection;
+            continue;
+        }
+        // Both threads are at their ends.
+        connection->readerThread->join();
+        delete connection->readerThread;
+        connection->writerThread->join();
+        delete connection->writerThread;
+        close(connection->socket);
+        delete connection;
+    }
+    connections.resize(keptCount);
+}
+
+RNNServerRequest *RNNServer::parseRequest(RNNServerConnection *connection, char *data, fs_t length)
+{
+    // Every field is bounds-checked before it is read; requests with wrong values are answered with statusBadRequest by the caller.
+    char *end=data+length;
+    if(!RNNServerProtocol::canRead(data,end,sizeof(uint8_t)+sizeof(uint32_t)+sizeof(fs_t)))
+        return 0;
+    RNNServerRequest *request=new RNNServerRequest();
+    request->connection=connection;
+    request->arrivalTime=getTime();
+    request->type=(RNNServerRequestType)io::readUInt8(data);
+    request->requestId=io::readUInt32(data);
+    fs_t nameLength=io::readFsT(data);
+    bool ok=RNNServerProtocol::canRead(data,end,nameLength);
+    if(ok)
+    {
+        request->sessionName.assign(data,nameLength);
+        data+=nameLength;
+    }
+    request->session=0;
+    request->symbol=0;
+    request->symbolCount=0;
+    if(ok&&request->type==requestStepSymbol)
+    {
+        ok=RNNServerProtocol::canRead(data,end,sizeof(uint32_t));
+        if(ok)
+            request->symbol=io::readUInt32(data);
+    }
+    else if(ok&&request->type==requestStep)
+    {
+        ok=RNNServerProtocol::canRead(data,end,sizeof(uint32_t));
+        uint32_t valueCount=ok?io::readUInt32(data):0;
+        ok=ok&&RNNServerProtocol::canRead(data,end,(size_t)valueCount*sizeof(double));
+        if(ok)
+        {
+            request->input.resize(valueCount);
+            for(uint32_t i=0;i<valueCount;i++)
+            {
+                double value;
+                io::readDoubleArray(data,&value,1); // IEEE-754; io::readDouble() is a different encoding.
+                request->input[i]=(rnnfloat_t)value;
+            }
+        }
+    }
+    else if(ok&&request->type==requestGenerate)
+    {
+        ok=RNNServerProtocol::canRead(data,end,2*sizeof(uint32_t)+2*sizeof(double));
+        if(ok)
+        {
+            request->symbolCount=io::readUInt32(data);
+            io::readDoubleArray(data,&request->temperature,1);
+            request->topK=io::readUInt32(data);
+            io::readDoubleArray(data,&request->topP,1);
+        }
+    }
+    if(!ok)
+    {
+        delete request;
+        return 0;
+    }
+    return request;
+}
+
+void RNNServer::batchLoop()
+{
+    std::vector<RNNServerRequest*> batch;
+    std::vector<RNNSession*> batchSessions;
+    while(true)
+    {
+        if(hasFinishedConnections.exchange(false))
+            releaseFinishedConnections();
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            while(!stopping&&queuedRequests.empty()&&activeGenerations.empty()&&!hasFinishedConnections)
+                queueCondition.wait(lock);
+            if(stopping)
+                return;
+            if(queuedRequests.empty()&&activeGenerations.empty())
+                continue; // Only connections to release
+            // The window starts with the oldest waiting request. While generations are in progress, the batches follow each other
+            // immediately, and new requests join the next one.
+            if(activeGenerations.empty())
+            {
+                double deadline=queuedRequests.front()->arrivalTime+batchWindowSeconds;
+                while(!stopping&&queuedRequests.size()<maxBatchSize)
+                {
+                    double remainingSeconds=deadline-getTime();
+                    if(remainingSeconds<=0.0)
+                        break;
+                    queueCondition.wait_for(lock,std::chrono::duration<double>(remainingSeconds));
+                }
+                if(stopping)
+                    return;
+            }
+
+            // Generations in progress first, then the queued requests in order. A request for a session that is already part of the batch
+            // stays queued, and so do all later ones for that session.
+            batch.clear();
+            batchSessions.clear();
+            for(size_t i=0;i<activeGenerations.size();i++)
+            {
+                batch.push_back(activeGenerations[i]);
+                batchSessions.push_back(activeGenerations[i]->session);
+            }
+            activeGenerations.clear();
+            std::deque<RNNServerRequest*> deferredRequests;
+            while(!queuedRequests.empty())
+            {
+                RNNServerRequest *request=queuedRequests.front();
+                queuedRequests.pop_front();
+                RNNSession *session=getSession(request->sessionName);
+                bool isBusy=false;
+                for(size_t i=0;i<batchSessions.size()&&!isBusy;i++)
+                    isBusy=(batchSessions[i]==session);
+                if(isBusy||batch.size()>=maxBatchSize)
+                {
+                    deferredRequests.push_back(request);
+                    continue;
+                }
+                request->session=session;
+                batch.push_back(request);
+                batchSessions.push_back(session);
+            }
+            queuedRequests.swap(deferredRequests);
+        }
+        processBatch(batch);
+    }
+}
+
+void RNNServer::processBatch(std::vector<RNNServerRequest*> &batch)
+{
+    // Two forward passes at most: one-hot inputs (steps and generation) and dense inputs.
+    std::vector<RNNSession*> symbolSessions(batch.size());
+    std::vector<uint32_t> symbols(batch.size());
+    std::vector<RNNSession*> denseSessions(batch.size());
+    std::vector<const rnnfloat_t*> denseInputs(batch.size());
+    uint32_t symbolSessionCount=0;
+    uint32_t denseSessionCount=0;
+    for(size_t i=0;i<batch.size();i++)
+    {
+        RNNServerRequest *request=batch[i];
+        if(request->type==requestEndSession)
+            continue; // After the steps
+        if(request->type==requestStep)
+        {
+            denseSessions[denseSessionCount]=request->session;
+            denseInputs[denseSessionCount++]=request->input.data();
+            continue;
+        }
+        if(request->type==requestGenerate)
+        {
+            // The next symbol is sampled from the session's last output and then fed back.
+            if(!request->session->hasPreviousOutput)
+                continue; // Answered below
+            sampler->temperature=request->temperature;
+            sampler->topK=request->topK;
+            sampler->topP=request->topP;
+            request->symbol=sampler->sampleSymbol(request->session->previousOutput);
+            request->generatedSymbols.push_back(request->symbol);
+        }
+        symbolSessions[symbolSessionCount]=request->session;
+        symbols[symbolSessionCount++]=request->symbol;
+    }
+    if(symbolSessionCount>0)
+        executor->processSessionIndices(symbolSessions.data(),symbolSessionCount,symbols.data(),0);
+    if(denseSessionCount>0)
+        executor->processSessions(denseSessions.data(),denseSessionCount,denseInputs.data(),0);
+    {
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        stepCount+=symbolSessionCount+denseSessionCount;
+        batchCount+=(symbolSessionCount>0?1:0)+(denseSessionCount>0?1:0);
+    }
+
+    for(size_t i=0;i<batch.size();i++)
+    {
+        RNNServerRequest *request=batch[i];
+        if(request->type==requestEndSession)
+        {
+            sessions.erase(request->sessionName);
+            delete request->session;
+            respond(request,statusOk,responseBuffer,responseBufferSize);
+        }
+        else if(request->type==requestGenerate&&request->generatedSymbols.empty())
+            respond(request,statusNoOutput,responseBuffer,responseBufferSize);
+        else if(request->type==requestGenerate&&request->generatedSymbols.size()<request->symbolCount)
+            activeGenerations.push_back(request);
+        else
+            respond(request,statusOk,responseBuffer,responseBufferSize);
+    }
+}
+
+RNNSession *RNNServer::getSession(const std::string &name)
+{
+    std::unordered_map<std::string,RNNSession*>::iterator it=sessions.find(name);
+    if(it!=sessions.end())
+        return it->second;
+    RNNSession *session=new RNNSession(model->outputCount);
+    sessions[name]=session;
+    return session;
+}
+
+void RNNServer::respond(RNNServerRequest *request, RNNServerStatus status, char *&buffer, fs_t &bufferSize)
+{
+    fs_t pos;
+    RNNServerProtocol::beginFrame(buffer,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,request->requestId,pos,bufferSize);
+    io::writeUInt8ToBuffer(buffer,status,pos,bufferSize);
+    if(status==statusOk)
+    {
+        if(request->type==requestInfo)
+        {
+            io::writeUInt32ToBuffer(buffer,model->inputCount,pos,bufferSize);
+            io::writeUInt32ToBuffer(buffer,model->outputCount,pos,bufferSize);
+            io::writeUInt32ToBuffer(buffer,sampler->symbolCount,pos,bufferSize);
+        }
+        else if(request->type==requestStepSymbol||request->type==requestStep)
+        {
+            uint32_t outputCount=model->outputCount;
+            io::writeUInt32ToBuffer(buffer,outputCount,pos,bufferSize);
+            io::bufferCheck(buffer,pos+outputCount*sizeof(double),bufferSize);
+            for(uint32_t i=0;i<outputCount;i++)
+            {
+                double value=request->session->previousOutput[i];
+                io::writeDoubleArray(buffer,&value,1,pos);
+            }
+        }
+        else if(request->type==requestGenerate)
+        {
+            uint32_t symbolCount=(uint32_t)request->generatedSymbols.size();
+            io::writeUInt32ToBuffer(buffer,symbolCount,pos,bufferSize);
+            for(uint32_t i=0;i<symbolCount;i++)
+                io::writeUInt32ToBuffer(buffer,request->generatedSymbols[i],pos,bufferSize);
+        }
+    }
+    RNNServerProtocol::endFrame(buffer,pos);
+    // Queued for the connection's writer, so a slow client doesn't block the caller (the batch thread).
+    RNNServerConnection *connection=request->connection;
+    bool isFinished;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        if(!connection->isBroken)
+        {
+            if(connection->outboundLength+pos>RNNSERVER_MAX_OUTBOUND_BYTES)
+                connection->isBroken=true; // The client doesn't keep up; the writer disconnects it.
+            else
+                io::writeRawDataToBuffer(connection->outboundData,buffer,pos,connection->outboundLength,connection->outboundBufferSize);
+        }
+        connection->pendingRequestCount--;
+        isFinished=connection->isFinished();
+    }
+    connection->writerCondition.notify_one();
+    if(isFinished)
+        notifyConnectionFinished();
+    {
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        requestCount++;
+        latencies.push_back((getTime()-request->arrivalTime)*1e6);
+    }
+    delete request;
+}
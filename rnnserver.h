@@ -0,0 +1,158 @@
+#ifndef RNNSERVER_H
+#define RNNSERVER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "rnn.h"
+#include "rnnsession.h"
+#include "rnngenerator.h"
+#include "rnnserverprotocol.h"
+#include "text.h"
+
+// Result of RNNServer::getReport()
+struct RNNServerReport
+{
+    uint64_t requestCount; // Completed requests
+    uint64_t stepCount; // Session steps computed (a generation request takes one per symbol)
+    uint64_t batchCount; // Batched forward passes
+    double meanBatchSize; // Session steps per forward pass
+    double seconds; // Since the start or the last reset
+    double requestsPerSecond;
+    double stepsPerSecond;
+    double p50LatencyMicroseconds; // From the arrival of a request to its response
+    double p99LatencyMicroseconds;
+
+    std::string toString();
+};
+
+#define RNNSERVER_SEND_TIMEOUT_SECONDS 5 // A client that doesn't take its responses for this long is disconnected.
+#define RNNSERVER_MAX_OUTBOUND_BYTES (1<<26) // Unsent responses per connection; a client that lets more pile up is disconnected.
+
+class RNNServer;
+
+// A client connection. Its reader thread parses the requests, and its writer thread sends the responses, which are queued as frames in
+// "outboundData", so that a client that doesn't read can only stall its own writer. The batch thread releases the connection (joins the
+// threads, closes the socket) once the reader has ended, every request is answered and the writer has ended; until then, requests in flight
+// can refer to it.
+struct RNNServerConnection
+{
+    RNNServer *server;
+    int socket;
+    std::thread *readerThread;
+    std::thread *writerThread;
+
+    // Guarded by "mutex"
+    std::mutex mutex;
+    std::condition_variable writerCondition;
+    char *outboundData;
+    fs_t outboundLength;
+    fs_t outboundBufferSize;
+    uint32_t pendingRequestCount; // Parsed but not yet answered
+    bool isReaderDone;
+    bool isWriterDone;
+    bool isBroken; // Sending failed or timed out, or too many responses are pending; responses are dropped from then on.
+
+    inline bool isFinished() {return isReaderDone&&isWriterDone&&pendingRequestCount==0;}
+
+    RNNServerConnection(RNNServer *_server,int _socket);
+    ~RNNServerConnection();
+};
+
+struct RNNServerRequest
+{
+    RNNServerConnection *connection;
+    uint32_t requestId;
+    RNNServerRequestType type;
+    std::string sessionName;
+    double arrivalTime; // Seconds, steady clock
+    RNNSession *session; // Resolved by the batch thread
+
+    uint32_t symbol; // requestStepSymbol; during generation, the symbol to feed next
+    std::vector<rnnfloat_t> input; // requestStep
+
+    // requestGenerate
+    uint32_t symbolCount;
+    double temperature;
+    uint32_t topK;
+    double topP;
+    std::vector<uint32_t> generatedSymbols;
+};
+
+// Local inference server: serves named sessions (see RNNSession) of one model over a Unix domain socket, using the binary framing of
+// RNNServerProtocol. Requests are collected by one reader thread per connection, and a batch thread coalesces those that arrive within
+// "batchWindowSeconds" of the first one (up to "maxBatchSize" sessions) into one batched forward pass of an inference-only executor RNN that
+// shares the model's weights. A generation request takes part in consecutive batches, one symbol per batch, so long generations do not block
+// short requests. Requests for a session that is already part of a batch wait for the next one, so the steps of each session stay in order.
+// The sessions are only touched by the batch thread. The responses are sent by one writer thread per connection (see RNNServerConnection),
+// so a client that doesn't read its responses is disconnected after RNNSERVER_SEND_TIMEOUT_SECONDS instead of stalling the batches. POSIX only.
+
+class RNNServer
+{
+public:
+    RNN *model; // Not owned; its weights must not change while the server runs.
+    RNN *executor; // Owned; batch size maxBatchSize
+    RNNGenerator *sampler; // Owned; only its sampling is used.
+    uint32_t maxBatchSize;
+    double batchWindowSeconds;
+
+    bool start(const char *socketPath); // False if the socket couldn't be created; an existing file at "socketPath" is replaced.
+    void stop();
+    RNNServerReport getReport(bool reset); // "reset": start a new measurement interval
+
+    RNNServer(RNN *_model,uint32_t _maxBatchSize,double _batchWindowSeconds);
+    ~RNNServer();
+
+private:
+    int listenSocket;
+    std::string socketFileName;
+    std::thread *acceptThread;
+    std::thread *batchThread;
+    std::vector<RNNServerConnection*> connections; // Guarded by "connectionMutex"
+    std::mutex connectionMutex;
+    std::atomic<bool> hasFinishedConnections; // Wakes up the batch thread to release them
+
+    std::deque<RNNServerRequest*> queuedRequests; // Guarded by "queueMutex"
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::atomic<bool> stopping;
+
+    // Batch thread only
+    std::unordered_map<std::string,RNNSession*> sessions;
+    std::vector<RNNServerRequest*> activeGenerations;
+    char *responseBuffer;
+    fs_t responseBufferSize;
+
+    // Guarded by "statisticsMutex"
+    std::mutex statisticsMutex;
+    uint64_t requestCount;
+    uint64_t stepCount;
+    uint64_t batchCount;
+    double intervalStartTime;
+    std::vector<double> latencies; // Microseconds
+
+    static double getTime();
+    void acceptLoop();
+    void connectionLoop(RNNServerConnection *connection);
+    void writerLoop(RNNServerConnection *connection);
+    void notifyConnectionFinished();
+    void releaseFinishedConnections(); // Batch thread
+    RNNServerRequest *parseRequest(RNNServerConnection *connection,char *data,fs_t length);
+    void batchLoop();
+    void processBatch(std::vector<RNNServerRequest*> &batch);
+    RNNSession *getSession(const std::string &name);
+    // Sends the response and deletes the request; "buffer" belongs to the calling thread.
+    void respond(RNNServerRequest *request,RNNServerStatus status,char *&buffer,fs_t &bufferSize);
+};
+
+#endif // RNNSERVER_H
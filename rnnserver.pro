@@ -0,0 +1,58 @@
+QT += core
+QT -= gui
+
+TARGET = rnnserver
+CONFIG += console c++11 thread
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+# Local inference server (see rnnserver.h); POSIX only
+OBJECTS_DIR = rnnserver-objects
+
+# Single precision weights and activations (see rnnkernels.h):
+# DEFINES += rnnfloat_t=float
+
+SOURCES += rnnservermain.cpp \
+    rnn.cpp \
+    io.cpp \
+    text.cpp \
+    rnnstate.cpp \
+    alignedmemory.cpp \
+    rnnweights.cpp \
+    rnnkernels.cpp \
+    rnnactivation.cpp \
+    quantizedrnn.cpp \
+    rnnthreadteam.cpp \
+    rnntrainer.cpp \
+    rnncheckpoint.cpp \
+    mappedfile.cpp \
+    rnnmodelfile.cpp \
+    rnncorpusreader.cpp \
+    rnngenerator.cpp \
+    rnnbeamsearch.cpp \
+    rnnsession.cpp \
+    rnnserverprotocol.cpp \
+    rnnserver.cpp
+
+HEADERS += \
+    rnn.h \
+    io.h \
+    text.h \
+    rnnstate.h \
+    alignedmemory.h \
+    rnnweights.h \
+    rnnkernels.h \
+    rnnactivation.h \
+    quantizedrnn.h \
+    rnnthreadteam.h \
+    rnntrainer.h \
+    rnncheckpoint.h \
+    mappedfile.h \
+    rnnmodelfile.h \
+    rnncorpusreader.h \
+    rnngenerator.h \
+    rnnbeamsearch.h \
+    rnnsession.h \
+    rnnserverprotocol.h \
+    rnnserver.h
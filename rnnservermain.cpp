@@ -0,0 +1,94 @@
+// Local inference server (see RNNServer); usage: rnnserver <socket path> [model file or "-"] [batch window (microseconds)] [maximum batch size]
+// Without a model file, a randomly initialized model (96 symbols, softmax outputs) is served, which is enough for measuring the serving overhead.
+
+#include <stdlib.h>
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "text.h"
+
+#include "rnn.h"
+#include "rnnmodelfile.h"
+#include "rnnserver.h"
+
+using namespace std;
+
+static volatile sig_atomic_t interrupted=0;
+
+static void handleSignal(int)
+{
+    interrupted=1;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc<2)
+    {
+        cerr<<"Usage: "<<argv[0]<<" <socket path> [model file or \"-\"] [batch window (microseconds)] [maximum batch size]"<<endl;
+        return 1;
+    }
+    const char *socketPath=argv[1];
+    double batchWindowSeconds=(argc>3?atof(argv[3]):500.0)/1e6;
+    uint32_t maxBatchSize=argc>4?(uint32_t)atoi(argv[4]):64;
+    if(maxBatchSize==0)
+        maxBatchSize=1;
+
+    RNNModelFile *modelFile=0;
+    RNN *model;
+    if(argc>2&&strcmp(argv[2],"-")!=0)
+    {
+        modelFile=new RNNModelFile();
+        if(!modelFile->open(argv[2]))
+        {
+            cerr<<"Couldn't open model file "<<argv[2]<<endl;
+            delete modelFile;
+            return 1;
+        }
+        model=modelFile->createRNN();
+    }
+    else
+    {
+        uint32_t symbolCount=96;
+        uint32_t layerNeuronCounts[3]={0 /*Set by the RNN*/,128,symbolCount};
+        model=new RNN(symbolCount,symbolCount,0,0.0,0.0,0.0,3,layerNeuronCounts);
+        model->outputType=outputSoftmax;
+        model->setInferenceOnly();
+    }
+
+    RNNServer *server=new RNNServer(model,maxBatchSize,batchWindowSeconds);
+    if(!server->start(socketPath))
+    {
+        cerr<<"Couldn't listen on "<<socketPath<<endl;
+        delete server;
+        delete model;
+        delete modelFile;
+        return 1;
+    }
+    signal(SIGINT,handleSignal);
+    signal(SIGTERM,handleSignal);
+    char *str=text::doubleToStringWithFixedPrecision(batchWindowSeconds*1e6,0);
+    cout<<"Listening on "<<socketPath<<" (inputs: "<<model->inputCount<<", outputs: "<<model->outputCount<<", batch window: "<<str
+       <<" us, maximum batch size: "<<maxBatchSize<<")"<<endl;
+    free(str);
+
+    // A report every 5 seconds in which requests were served
+    const uint32_t reportIntervalTicks=50;
+    for(uint32_t tick=1;!interrupted;tick++)
+    {
+        usleep(100000);
+        if(tick%reportIntervalTicks==0)
+        {
+            RNNServerReport report=server->getReport(true);
+            if(report.requestCount>0)
+                cout<<report.toString()<<endl;
+        }
+    }
+    server->stop();
+    delete server;
+    delete model;
+    delete modelFile;
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "rnnserverprotocol.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+void RNNServerProtocol::beginFrame(char *&buffer, fs_t &pos, fs_t &bufferSize)
+{
+    pos=0;
+    io::writeUInt32ToBuffer(buffer,0,pos,bufferSize); // Payload length, put by endFrame()
+}
+
+void RNNServerProtocol::endFrame(char *buffer, fs_t pos)
+{
+    io::putUInt32(buffer,pos-sizeof(uint32_t),0);
+}
+
+void RNNServerProtocol::writeRequestHeader(char *&buffer, fs_t &pos, fs_t &bufferSize, RNNServerRequestType type, uint32_t requestId, const char *sessionName)
+{
+    io::writeUInt8ToBuffer(buffer,type,pos,bufferSize);
+    io::writeUInt32ToBuffer(buffer,requestId,pos,bufferSize);
+    io::writeFixedLengthDataToBuffer(buffer,strlen(sessionName),sessionName,pos,bufferSize);
+}
+
+void RNNServerProtocol::writeDoublesToBuffer(char *&buffer, fs_t &pos, fs_t &bufferSize, const double *values, uint32_t count)
+{
+    io::writeUInt32ToBuffer(buffer,count,pos,bufferSize);
+    io::writeDoubleArrayToBuffer(buffer,values,count,pos,bufferSize);
+}
+
+bool RNNServerProtocol::writeAll(int socket, const char *data, size_t length)
+{
+    while(length>0)
+    {
+        ssize_t written=send(socket,data,length,MSG_NOSIGNAL); // A closed peer must not raise SIGPIPE.
+        if(written<0&&errno==EINTR)
+            continue;
+        if(written<=0)
+            return false;
+        data+=written;
+        length-=written;
+    }
+    return true;
+}
+
+bool RNNServerProtocol::readAll(int socket, char *data, size_t length)
+{
+    while(length>0)
+    {
+        ssize_t received=recv(socket,data,length,0);
+        if(received<0&&errno==EINTR)
+            continue;
+        if(received<=0)
+            return false;
+        data+=received;
+        length-=received;
+    }
+    return true;
+}
+
+bool RNNServerProtocol::readFrame(int socket, char *&buffer, fs_t &bufferSize, fs_t &length)
+{
+    char lengthData[sizeof(uint32_t)];
+    if(!readAll(socket,lengthData,sizeof(uint32_t)))
+        return false;
+    char *data=lengthData;
+    length=io::readUInt32(data);
+    if(length>RNNSERVERPROTOCOL_MAX_FRAME_SIZE)
+        return false;
+    io::bufferCheck(buffer,length,bufferSize);
+    return readAll(socket,buffer,length);
+}
+
+double RNNServerProtocol::getPercentile(std::vector<double> &values, double fraction)
+{
+    if(values.empty())
+        return 0.0;
+    size_t index=(size_t)(fraction*(values.size()-1)+0.5);
+    std::nth_element(values.begin(),values.begin()+index,values.end());
+    return values[index];
+}
@@ -0,0 +1,65 @@
+#ifndef RNNSERVERPROTOCOL_H
+#define RNNSERVERPROTOCOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "io.h"
+
+#define RNNSERVERPROTOCOL_MAX_FRAME_SIZE (1<<24) // Bytes; larger frames are rejected (the connection is closed).
+
+enum RNNServerRequestType
+{
+    requestInfo=0, // Model dimensions; no session
+    requestStepSymbol=1, // One step with a one-hot input
+    requestStep=2, // One step with dense input values
+    requestGenerate=3, // Samples symbols (see RNNGenerator); the session must have been stepped before.
+    requestEndSession=4 // Deletes the session.
+};
+
+enum RNNServerStatus
+{
+    statusOk=0,
+    statusBadRequest=1, // Unknown type, wrong sizes, a symbol out of range, an input, temperature or topP that isn't finite (topP: in (0, 1])
+    statusNoOutput=2 // Generation requested for a session without a previous step
+};
+
+// Binary framing of the inference server (see RNNServer), written and read with io (little-endian). Every message is a frame: payload length
+// (uint32), payload.
+//
+//   Request: type (uint8), request ID (uint32, echoed in the response), session name (fs_t length, bytes), then depending on the type:
+//     requestStepSymbol: symbol (uint32)
+//     requestStep: value count (uint32), values (IEEE-754 double each)
+//     requestGenerate: symbol count (uint32, so that the response fits into a frame), temperature (IEEE-754 double), topK (uint32), topP (IEEE-754 double)
+//   Response: request ID (uint32), status (uint8), then if the status is statusOk:
+//     requestInfo: inputCount, outputCount, symbolCount (uint32 each)
+//     requestStepSymbol, requestStep: output count (uint32), outputs (IEEE-754 double each)
+//     requestGenerate: symbol count (uint32), symbols (uint32 each)
+//
+// Requests on one connection can be pipelined; responses may arrive in a different order (they are matched by the request ID).
+
+class RNNServerProtocol
+{
+public:
+    // A frame is built in a buffer: beginFrame(), the io::write*ToBuffer() calls of the payload, endFrame(); then it is sent with writeAll().
+    static void beginFrame(char *&buffer,fs_t &pos,fs_t &bufferSize);
+    static void endFrame(char *buffer,fs_t pos);
+    static void writeRequestHeader(char *&buffer,fs_t &pos,fs_t &bufferSize,RNNServerRequestType type,uint32_t requestId,const char *sessionName);
+    static void writeDoublesToBuffer(char *&buffer,fs_t &pos,fs_t &bufferSize,const double *values,uint32_t count); // Count and values
+
+    // Blocking socket IO; false if the connection was closed or failed (or the frame is too large). readFrame() grows the buffer as needed
+    // and returns the payload length in "length".
+    static bool writeAll(int socket,const char *data,size_t length);
+    static bool readAll(int socket,char *data,size_t length);
+    static bool readFrame(int socket,char *&buffer,fs_t &bufferSize,fs_t &length);
+
+    // Bounds check for reading a received payload: true if "size" more bytes are available before "end"
+    static inline bool canRead(const char *data,const char *end,size_t size) {return (size_t)(end-data)>=size;}
+
+    static double getPercentile(std::vector<double> &values,double fraction); // Reorders "values"; 0 if empty
+};
+
+#endif // RNNSERVERPROTOCOL_H
@@ -0,0 +1,20 @@
+#include "rnnsession.h"
+
+RNNSession::RNNSession(uint32_t _outputCount)
+{
+    outputCount=_outputCount;
+    previousOutput=(rnnfloat_t*)malloc(outputCount*sizeof(rnnfloat_t));
+    hasPreviousOutput=false;
+    stepCount=0;
+}
+
+RNNSession::~RNNSession()
+{
+    free(previousOutput);
+}
+
+void RNNSession::reset()
+{
+    hasPreviousOutput=false;
+    stepCount=0;
+}
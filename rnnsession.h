@@ -0,0 +1,30 @@
+#ifndef RNNSESSION_H
+#define RNNSESSION_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rnnkernels.h" // rnnfloat_t
+
+// Recurrent context of one independent stream, e.g. a user of a served model. The state of this (Jordan-type) network between two steps is
+// just the previous output, so that is all a session holds: creating or deleting it costs O(outputCount), and thousands of sessions can share
+// one model. Sessions are stepped by an RNN that serves as the executor (see RNN::processSessions()); the executor's weights are only read,
+// so executors that share one set of weights (e.g. one per thread, made inference-only) can step different sessions concurrently.
+
+class RNNSession
+{
+public:
+    rnnfloat_t *previousOutput; // Dimensions: outputs; only valid if hasPreviousOutput is true
+    uint32_t outputCount;
+    bool hasPreviousOutput; // False: the next step starts a new sequence (zero previous output, like a fresh RNN)
+    uint64_t stepCount; // Steps processed so far
+
+
+    void reset(); // Starts a new sequence.
+
+    RNNSession(uint32_t _outputCount);
+    ~RNNSession();
+};
+
+#endif // RNNSESSION_H
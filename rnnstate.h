@@ -3,35 +3,48 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
-#include <ctime>
+
+#include "alignedmemory.h"
+#include "rnnkernels.h" // rnnfloat_t
 
 // Here, the input and output layers are meant to be included in "_layerCount" and "_layerNeuronCounts".
 
+// Activations of a single computational step of "batchSize" independent sequences. The weights are not part of the state; they are stored
+// once, in RNN::weights.
+
 class RNNState
 {
 public:
-    // Dimensions: layers -> neurons in this layer -> neurons in next layer
-    double ***weights;
-
-    // Dimensions: layers -> neuron values / neuron bias weights
-    double **neuronValues;
-    double **biasWeights;
+    // Dimensions: layers -> sequences -> neuron values (all layers share one contiguous block)
+    // The values of a sequence are padded to neuronValueStrides[layer] elements; use getNeuronValues() to address a sequence.
+    rnnfloat_t **neuronValues;
+    uint32_t *neuronValueStrides;
 
     uint32_t *layerNeuronCounts;
     uint32_t layerCount;
 
-    double *input;
-    double *previousOutput;
-    double *output;
 
+    // Dimensions: sequences -> desired output values (the targets of this step, for learning); only valid if hasDesiredOutputs is true
+    rnnfloat_t *desiredOutputs;
+    bool hasDesiredOutputs;
+
+    uint32_t batchSize;
     uint32_t inputCount;
     uint32_t outputCount;
     uint32_t inputAndOutputCount;
 
 
+    inline rnnfloat_t *getNeuronValues(uint32_t layer,uint32_t sequence) {return neuronValues[layer]+(size_t)sequence*neuronValueStrides[layer];}
+    // The input and the previous output are the values of the input layer, the output those of the output layer; they are not stored twice.
+    inline rnnfloat_t *getInput(uint32_t sequence) {return getNeuronValues(0,sequence);}
+    inline rnnfloat_t *getPreviousOutput(uint32_t sequence) {return getNeuronValues(0,sequence)+inputCount;}
+    inline rnnfloat_t *getOutput(uint32_t sequence) {return getNeuronValues(layerCount-1,sequence);}
+    inline rnnfloat_t *getDesiredOutput(uint32_t sequence) {return desiredOutputs+(size_t)sequence*outputCount;}
+
 public:
-    RNNState(RNNState *copyFrom,uint32_t _inputCount=0,uint32_t _outputCount=0,uint32_t _layerCount=0,uint32_t *_layerNeuronCounts=0);
+    RNNState(uint32_t _inputCount,uint32_t _outputCount,uint32_t _layerCount,uint32_t *_layerNeuronCounts,uint32_t _batchSize=1);
     ~RNNState();
 };
 
@@ -0,0 +1,106 @@
+#include "rnnthreadteam.h"
+
+void RNNThreadTeam::getRange(uint32_t count, uint32_t granularity, uint32_t threadIndex, uint32_t threadCount, uint32_t &begin, uint32_t &end)
+{
+    uint32_t unitCount=(count+granularity-1)/granularity;
+    uint32_t unitsPerThread=unitCount/threadCount;
+    uint32_t remainingUnits=unitCount%threadCount; // The first "remainingUnits" threads get one more unit
+    uint32_t firstUnit=threadIndex*unitsPerThread+(threadIndex<remainingUnits?threadIndex:remainingUnits);
+    uint32_t threadUnitCount=unitsPerThread+(threadIndex<remainingUnits?1:0);
+    begin=firstUnit*granularity;
+    end=(firstUnit+threadUnitCount)*granularity;
+    if(begin>count)
+        begin=count;
+    if(end>count)
+        end=count;
+}
+
+RNNThreadTeam::RNNThreadTeam(uint32_t _threadCount)
+{
+    threadCount=_threadCount;
+    if(threadCount==0)
+        threadCount=std::thread::hardware_concurrency();
+    if(threadCount==0)
+        threadCount=1;
+    currentTask=0;
+    currentContext=0;
+    generation=0;
+    pendingThreadCount=0;
+    sleepingThreadCount=0;
+    stopping=false;
+
+    threads=(std::thread**)malloc(threadCount*sizeof(std::thread*));
+    threads[0]=0; // The calling thread
+    for(uint32_t threadIndex=1;threadIndex<threadCount;threadIndex++)
+        threads[threadIndex]=new std::thread(&RNNThreadTeam::workerLoop,this,threadIndex);
+}
+
+RNNThreadTeam::~RNNThreadTeam()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeUpMutex);
+        stopping=true;
+        generation++;
+    }
+    wakeUpCondition.notify_all();
+    for(uint32_t threadIndex=1;threadIndex<threadCount;threadIndex++)
+    {
+        threads[threadIndex]->join();
+        delete threads[threadIndex];
+    }
+    free(threads);
+}
+
+void RNNThreadTeam::run(Task task, void *context)
+{
+    if(threadCount==1)
+    {
+        task(context,0,1);
+        return;
+    }
+
+    currentTask=task;
+    currentContext=context;
+    pendingThreadCount=threadCount-1;
+    generation++; // Publishes the task (sequentially consistent)
+    if(sleepingThreadCount>0)
+    {
+        // Locking makes sure that a worker that is about to sleep either sees the new generation or is already waiting.
+        std::lock_guard<std::mutex> lock(wakeUpMutex);
+        wakeUpCondition.notify_all();
+    }
+
+    task(context,0,threadCount);
+
+    for(uint32_t poll=0;pendingThreadCount>0;poll++)
+    {
+        if(poll>=RNNTHREADTEAM_SPIN_COUNT)
+            std::this_thread::yield();
+    }
+}
+
+void RNNThreadTeam::workerLoop(uint32_t threadIndex)
+{
+    uint32_t seenGeneration=0;
+    for(;;)
+    {
+        // Wait for the next task: spin first, then sleep.
+        uint32_t poll=0;
+        while(generation==seenGeneration&&poll<RNNTHREADTEAM_SPIN_COUNT)
+            poll++;
+        if(generation==seenGeneration)
+        {
+            std::unique_lock<std::mutex> lock(wakeUpMutex);
+            sleepingThreadCount++;
+            while(generation==seenGeneration)
+                wakeUpCondition.wait(lock);
+            sleepingThreadCount--;
+        }
+        seenGeneration=generation;
+        if(stopping)
+            return;
+
+        currentTask(currentContext,threadIndex,threadCount);
+        pendingThreadCount--;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef RNNTHREADTEAM_H
+#define RNNTHREADTEAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Number of polls before a waiting thread starts yielding (the caller) or goes to sleep (a worker). Work items in this program are
+// layer transitions, which typically take microseconds, so a short spin avoids most sleep/wake-up round trips.
+#define RNNTHREADTEAM_SPIN_COUNT 4096
+
+// A persistent team of threads for splitting one operation (e.g. a layer transition) into parts. The threads are started once, in the
+// constructor; run() only wakes them up, and returns when all parts are done, so consecutive run() calls act as barriers.
+// run() must not be called by several threads at once; a team can be shared by several RNNs that are used by the same thread.
+
+class RNNThreadTeam
+{
+public:
+    typedef void (*Task)(void *context,uint32_t threadIndex,uint32_t threadCount);
+
+    uint32_t threadCount; // Including the calling thread, which executes part 0
+
+    // Splits "count" items into "threadCount" parts, each a multiple of "granularity" items (except for the last one).
+    static void getRange(uint32_t count,uint32_t granularity,uint32_t threadIndex,uint32_t threadCount,uint32_t &begin,uint32_t &end);
+
+    void run(Task task,void *context); // Calls task(context,threadIndex,threadCount) on every thread of the team.
+
+    RNNThreadTeam(uint32_t _threadCount=0); // 0: one thread per hardware thread
+    ~RNNThreadTeam();
+
+private:
+    std::thread **threads;
+    Task currentTask;
+    void *currentContext;
+    std::atomic<uint32_t> generation; // Incremented for every run() call
+    std::atomic<uint32_t> pendingThreadCount; // Workers that have not finished the current task
+    std::atomic<uint32_t> sleepingThreadCount;
+    std::atomic<bool> stopping;
+    std::mutex wakeUpMutex;
+    std::condition_variable wakeUpCondition;
+
+    void workerLoop(uint32_t threadIndex);
+};
+
+#endif // RNNTHREADTEAM_H
@@ -0,0 +1,238 @@
+#include "rnntrainer.h"
+
+#include <chrono>
+
+std::string RNNTrainingReport::toString()
+{
+    std::string out;
+    char *str=text::unsignedIntToString(stepCount);
+    out+="Steps: ";
+    out+=str;
+    free(str);
+    str=text::unsignedIntToString(sequenceCount);
+    out+=" x ";
+    out+=str;
+    out+=" sequences";
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(seconds,3);
+    out+=", time: ";
+    out+=str;
+    out+=" s";
+    free(str);
+    str=text::doubleToStringWithFixedPrecision(sequenceStepsPerSecond,0);
+    out+=", throughput: ";
+    out+=str;
+    out+=" steps/s";
+    free(str);
+    str=text::doubleToString(initialMeanSquaredError);
+    out+=", MSE: ";
+    out+=str;
+    free(str);
+    str=text::doubleToString(finalMeanSquaredError);
+    out+=" -> ";
+    out+=str;
+    free(str);
+    return out;
+}
+
+RNNTrainer::RNNTrainer(RNN *_rnn, uint32_t _sequenceCount, RNNThreadTeam *_threadTeam, bool _hogwild)
+{
+    hogwild=_hogwild;
+    rnn=_rnn;
+    threadTeam=_threadTeam;
+    sequenceCount=_sequenceCount;
+    if(sequenceCount==0||!rnn->ownsWeights)
+        throw;
+    workerCount=threadTeam->threadCount<sequenceCount?threadTeam->threadCount:sequenceCount;
+
+    workers=(RNN**)malloc(workerCount*sizeof(RNN*));
+    firstSequences=(uint32_t*)malloc((workerCount+1)*sizeof(uint32_t));
+    workerWeightDiffs=(RNNWeights**)malloc(workerCount*sizeof(RNNWeights*));
+    for(uint32_t worker=0;worker<workerCount;worker++)
+    {
+        uint32_t endSequence;
+        RNNThreadTeam::getRange(sequenceCount,1,worker,workerCount,firstSequences[worker],endSequence);
+        firstSequences[worker+1]=endSequence;
+        workers[worker]=new RNN(rnn->inputCount,rnn->outputCount,rnn->backpropagationSteps,rnn->learningRate,rnn->momentum,rnn->weightDecay,rnn->layerCount,rnn->layerNeuronCounts,
+                                endSequence-firstSequences[worker],rnn->weights);
+        workers[worker]->kernelType=rnn->kernelType;
+        workers[worker]->activationType=rnn->activationType;
+        workers[worker]->outputType=rnn->outputType;
+        workerWeightDiffs[worker]=new RNNWeights(rnn->layerCount,rnn->layerNeuronCounts,false);
+        if(hogwild)
+        {
+            // The worker learns on its own: it gets its own momentum terms and gradient buffer, and applies sparse updates to the shared
+            // weights. Every worker updates as often as the whole trainer would in synchronous mode, so each one applies its share of the decay.
+            workers[worker]->previousWeightDiff=new RNNWeights(rnn->layerCount,rnn->layerNeuronCounts,false);
+            workers[worker]->accumulatedWeightDiff=new RNNWeights(rnn->layerCount,rnn->layerNeuronCounts,false);
+            workers[worker]->weightDecay=rnn->weightDecay/workerCount;
+            workers[worker]->setSparseUpdates();
+            workers[worker]->setLearningInterval(rnn->learningInterval!=0?rnn->learningInterval:rnn->stateArraySize);
+        }
+    }
+    workerInitialSquaredErrors=(double*)malloc(workerCount*sizeof(double));
+    workerFinalSquaredErrors=(double*)malloc(workerCount*sizeof(double));
+    currentInputSequences=0;
+    currentStepCount=0;
+    currentInputs=0;
+    currentOutputs=0;
+    currentDesiredOutputs=0;
+}
+
+RNNTrainer::~RNNTrainer()
+{
+    for(uint32_t worker=0;worker<workerCount;worker++)
+    {
+        delete workers[worker];
+        delete workerWeightDiffs[worker];
+    }
+    free(workers);
+    free(firstSequences);
+    free(workerWeightDiffs);
+    free(workerInitialSquaredErrors);
+    free(workerFinalSquaredErrors);
+}
+
+void RNNTrainer::processBatch(const rnnfloat_t *const *inputs, rnnfloat_t **outputs)
+{
+    currentInputs=inputs;
+    currentOutputs=outputs;
+    threadTeam->run(&processTask,this);
+}
+
+void RNNTrainer::learnBatch(rnnfloat_t ***desiredOutputs)
+{
+    currentDesiredOutputs=desiredOutputs;
+    threadTeam->run(&computeGradientsTask,this);
+    // All gradients are complete here (run() is a barrier).
+    threadTeam->run(&applyGradientsTask,this);
+}
+
+RNNTrainingReport RNNTrainer::trainAsynchronously(rnnfloat_t ***inputs, rnnfloat_t ***desiredOutputs, uint32_t stepCount)
+{
+    if(!hogwild)
+        throw;
+    currentInputSequences=inputs;
+    currentDesiredOutputs=desiredOutputs;
+    currentStepCount=stepCount;
+    std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+    threadTeam->run(&trainAsynchronouslyTask,this);
+    double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-startTime).count();
+
+    RNNTrainingReport report;
+    report.stepCount=stepCount;
+    report.sequenceCount=sequenceCount;
+    report.seconds=seconds;
+    report.sequenceStepsPerSecond=seconds>0.0?(double)stepCount*sequenceCount/seconds:0.0;
+    report.initialMeanSquaredError=0.0;
+    report.finalMeanSquaredError=0.0;
+    for(uint32_t worker=0;worker<workerCount;worker++)
+    {
+        report.initialMeanSquaredError+=workerInitialSquaredErrors[worker];
+        report.finalMeanSquaredError+=workerFinalSquaredErrors[worker];
+    }
+    uint32_t tenthStepCount=stepCount<10?1:stepCount/10;
+    double valueCountPerTenth=(double)tenthStepCount*sequenceCount*rnn->outputCount;
+    report.initialMeanSquaredError/=valueCountPerTenth;
+    report.finalMeanSquaredError/=valueCountPerTenth;
+    return report;
+}
+
+void RNNTrainer::trainAsynchronouslyTask(void *context, uint32_t threadIndex, uint32_t threadCount)
+{
+    RNNTrainer *trainer=(RNNTrainer*)context;
+    uint32_t firstWorker,endWorker;
+    RNNThreadTeam::getRange(trainer->workerCount,1,threadIndex,threadCount,firstWorker,endWorker);
+    uint32_t stepCount=trainer->currentStepCount;
+    uint32_t tenthStepCount=stepCount<10?1:stepCount/10;
+    uint32_t outputCount=trainer->rnn->outputCount;
+    for(uint32_t worker=firstWorker;worker<endWorker;worker++)
+    {
+        RNN *workerRnn=trainer->workers[worker];
+        uint32_t firstSequence=trainer->firstSequences[worker];
+        uint32_t workerSequenceCount=workerRnn->batchSize;
+        // Dimensions: sequences of this worker -> values of the current step
+        const rnnfloat_t **stepInputs=(const rnnfloat_t**)malloc(workerSequenceCount*sizeof(rnnfloat_t*));
+        const rnnfloat_t **stepDesiredOutputs=(const rnnfloat_t**)malloc(workerSequenceCount*sizeof(rnnfloat_t*));
+        double initialSquaredError=0.0;
+        double finalSquaredError=0.0;
+        for(uint32_t step=0;step<stepCount;step++)
+        {
+            for(uint32_t sequence=0;sequence<workerSequenceCount;sequence++)
+            {
+                stepInputs[sequence]=trainer->currentInputSequences[firstSequence+sequence][step];
+                stepDesiredOutputs[sequence]=trainer->currentDesiredOutputs[firstSequence+sequence][step];
+            }
+            workerRnn->processBatch(stepInputs,0);
+            if(step<tenthStepCount||step>=stepCount-tenthStepCount)
+            {
+                RNNState *currentState=workerRnn->getCurrentState();
+                double squaredError=0.0;
+                for(uint32_t sequence=0;sequence<workerSequenceCount;sequence++)
+                {
+                    const rnnfloat_t *output=currentState->getOutput(sequence);
+                    for(uint32_t i=0;i<outputCount;i++)
+                        squaredError+=(stepDesiredOutputs[sequence][i]-output[i])*(stepDesiredOutputs[sequence][i]-output[i]);
+                }
+                if(step<tenthStepCount)
+                    initialSquaredError+=squaredError;
+                if(step>=stepCount-tenthStepCount)
+                    finalSquaredError+=squaredError;
+            }
+            workerRnn->setDesiredOutputs(stepDesiredOutputs); // Learns every k1 steps.
+        }
+        workerRnn->applyPendingWeightDecay();
+        trainer->workerInitialSquaredErrors[worker]=initialSquaredError;
+        trainer->workerFinalSquaredErrors[worker]=finalSquaredError;
+        free(stepInputs);
+        free(stepDesiredOutputs);
+    }
+}
+
+void RNNTrainer::processTask(void *context, uint32_t threadIndex, uint32_t threadCount)
+{
+    RNNTrainer *trainer=(RNNTrainer*)context;
+    uint32_t firstWorker,endWorker;
+    RNNThreadTeam::getRange(trainer->workerCount,1,threadIndex,threadCount,firstWorker,endWorker);
+    for(uint32_t worker=firstWorker;worker<endWorker;worker++)
+    {
+        uint32_t firstSequence=trainer->firstSequences[worker];
+        trainer->workers[worker]->processBatch(trainer->currentInputs+firstSequence,trainer->currentOutputs!=0?trainer->currentOutputs+firstSequence:0);
+    }
+}
+
+void RNNTrainer::computeGradientsTask(void *context, uint32_t threadIndex, uint32_t threadCount)
+{
+    RNNTrainer *trainer=(RNNTrainer*)context;
+    uint32_t firstWorker,endWorker;
+    RNNThreadTeam::getRange(trainer->workerCount,1,threadIndex,threadCount,firstWorker,endWorker);
+    for(uint32_t worker=firstWorker;worker<endWorker;worker++)
+    {
+        RNN *workerRnn=trainer->workers[worker];
+        workerRnn->storeDesiredOutputs(trainer->currentDesiredOutputs+trainer->firstSequences[worker]);
+        workerRnn->computeGradients(trainer->workerWeightDiffs[worker],workerRnn->getAvailableStepsBack()+1);
+    }
+}
+
+void RNNTrainer::applyGradientsTask(void *context, uint32_t threadIndex, uint32_t threadCount)
+{
+    // Reduction: the gradients of all workers are summed up into those of worker 0, one parameter range per thread. The ranges are multiples
+    // of a cache line, so that no two threads write to the same line.
+    RNNTrainer *trainer=(RNNTrainer*)context;
+    size_t parameterCount=trainer->rnn->weights->parameterCount;
+    uint32_t firstParameter,endParameter;
+    RNNThreadTeam::getRange((uint32_t)parameterCount,ALIGNEDMEMORY_ALIGNMENT/sizeof(rnnfloat_t),threadIndex,threadCount,firstParameter,endParameter);
+    if(firstParameter==endParameter)
+        return;
+
+    rnnfloat_t *parameterDiff=trainer->workerWeightDiffs[0]->parameters;
+    for(uint32_t worker=1;worker<trainer->workerCount;worker++)
+    {
+        rnnfloat_t *workerParameterDiff=trainer->workerWeightDiffs[worker]->parameters;
+        for(size_t parameter=firstParameter;parameter<endParameter;parameter++)
+            parameterDiff[parameter]+=workerParameterDiff[parameter];
+        memset(workerParameterDiff+firstParameter,0,(endParameter-firstParameter)*sizeof(rnnfloat_t));
+    }
+    trainer->rnn->applyGradients(trainer->workerWeightDiffs[0],firstParameter,endParameter);
+    memset(parameterDiff+firstParameter,0,(endParameter-firstParameter)*sizeof(rnnfloat_t));
+}
@@ -0,0 +1,82 @@
+#ifndef RNNTRAINER_H
+#define RNNTRAINER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "rnn.h"
+#include "rnnthreadteam.h"
+
+// Result of RNNTrainer::trainAsynchronously()
+struct RNNTrainingReport
+{
+    uint32_t stepCount;
+    uint32_t sequenceCount;
+    double seconds;
+    double sequenceStepsPerSecond;
+    // Mean squared error of the outputs (before learning from them) in the first and the last tenth of the steps, over all sequences
+    double initialMeanSquaredError;
+    double finalMeanSquaredError;
+
+    std::string toString();
+};
+
+// Data-parallel training of one RNN on "sequenceCount" independent sequences. The sequences are split into contiguous ranges, one per worker;
+// every worker is an RNN that shares the weights of "rnn" and has its own state history. learnBatch() lets all workers compute their
+// gradients in parallel, then sums them up and applies them to "rnn", with every thread handling one range of the parameters.
+// The result is the same as rnn->learnBatch() with a batch size of "sequenceCount", up to floating-point rounding.
+//
+// Hogwild mode (opt-in): the workers train asynchronously, without any synchronization between them. Every worker has its own gradient
+// buffer and momentum terms and applies its updates directly to the shared weights (see RNN::setSparseUpdates()): of weight layer 0, only
+// the columns of the inputs that were nonzero since its last update are written (few with one-hot inputs), plus the previous output
+// columns, the bias weights and the upper layers. Each worker applies 1/workerCount of the weight decay, lazily for skipped columns.
+// The updates use relaxed atomic loads and stores, so concurrent updates of the same weight may lose one of them. The forward and
+// backward passes read the shared weights with plain (vectorized) loads while other workers write them; this is formally a data race in
+// C++ and relies on aligned loads and stores not tearing on the supported platforms. The result is not deterministic.
+
+class RNNTrainer
+{
+public:
+    RNN *rnn; // Owns the weights and momentum terms; its own state history is not used. Not owned.
+    RNNThreadTeam *threadTeam; // Not owned
+    uint32_t sequenceCount;
+    uint32_t workerCount; // The thread count of the team, or the sequence count if it is smaller
+
+    RNN **workers; // Dimensions: workers
+    uint32_t *firstSequences; // Dimensions: workers+1; worker "w" processes the sequences [firstSequences[w], firstSequences[w+1])
+    RNNWeights **workerWeightDiffs; // Dimensions: workers; zeroes between learnBatch() calls
+    bool hogwild;
+
+
+    // Same protocol as RNN::processBatch() and RNN::learnBatch(); Dimensions: inputs/outputs: sequences -> values;
+    // desiredOutputs: sequences -> steps (oldest first) -> values
+    void processBatch(const rnnfloat_t *const *inputs,rnnfloat_t **outputs);
+    void learnBatch(rnnfloat_t ***desiredOutputs);
+
+    // Hogwild mode only. Dimensions: inputs/desiredOutputs: sequences -> steps -> values. Every worker runs through all steps of its sequences
+    // on its own, learning every k1 steps as set by rnn->setLearningInterval() (or every backpropagationSteps+1 steps if it is 0).
+    RNNTrainingReport trainAsynchronously(rnnfloat_t ***inputs,rnnfloat_t ***desiredOutputs,uint32_t stepCount);
+
+    RNNTrainer(RNN *_rnn,uint32_t _sequenceCount,RNNThreadTeam *_threadTeam,bool _hogwild=false);
+    ~RNNTrainer();
+
+private:
+    // Arguments of the current call, for the tasks
+    const rnnfloat_t *const *currentInputs;
+    rnnfloat_t **currentOutputs;
+    rnnfloat_t ***currentDesiredOutputs;
+    rnnfloat_t ***currentInputSequences;
+    uint32_t currentStepCount;
+    double *workerInitialSquaredErrors; // Dimensions: workers
+    double *workerFinalSquaredErrors; // Dimensions: workers
+
+    static void processTask(void *context,uint32_t threadIndex,uint32_t threadCount);
+    static void computeGradientsTask(void *context,uint32_t threadIndex,uint32_t threadCount);
+    static void applyGradientsTask(void *context,uint32_t threadIndex,uint32_t threadCount);
+    static void trainAsynchronouslyTask(void *context,uint32_t threadIndex,uint32_t threadCount);
+};
+
+#endif // RNNTRAINER_H
@@ -0,0 +1,83 @@
+#include "rnnweights.h"
+
+size_t RNNWeights::computeParameterLayout(uint32_t _layerCount, const uint32_t *_layerNeuronCounts, size_t *_weightOffsets, size_t *_biasWeightOffsets, uint32_t *_weightRowStrides)
+{
+    // Layout: [weights of weight layer 0][bias weights of weight layer 0][weights of weight layer 1]...
+    // Every section starts at an aligned offset.
+    size_t offset=0;
+    for(uint32_t weightLayer=0;weightLayer<_layerCount-1;weightLayer++)
+    {
+        uint32_t neuronsInThisLayer=_layerNeuronCounts[weightLayer];
+        uint32_t neuronsInNextLayer=_layerNeuronCounts[weightLayer+1];
+        uint32_t rowStride=alignedmemory::paddedCount(neuronsInThisLayer,sizeof(rnnfloat_t));
+        _weightRowStrides[weightLayer]=rowStride;
+        _weightOffsets[weightLayer]=offset;
+        offset+=(size_t)rowStride*neuronsInNextLayer;
+        _biasWeightOffsets[weightLayer]=offset;
+        offset+=alignedmemory::paddedCount(neuronsInNextLayer,sizeof(rnnfloat_t));
+    }
+    return offset;
+}
+
+void RNNWeights::clear()
+{
+    memset(parameters,0,parameterCount*sizeof(rnnfloat_t));
+}
+
+void RNNWeights::initializeLayout(uint32_t _layerCount, const uint32_t *_layerNeuronCounts)
+{
+    // Here, the input and output layers are meant to be included in "_layerCount" and "_layerNeuronCounts".
+    layerCount=_layerCount;
+    size_t layerCountArraySize=layerCount*sizeof(uint32_t);
+    layerNeuronCounts=(uint32_t*)malloc(layerCountArraySize);
+    memcpy(layerNeuronCounts,_layerNeuronCounts,layerCountArraySize);
+
+    uint32_t weightLayerCount=layerCount-1;
+    weightOffsets=(size_t*)malloc(weightLayerCount*sizeof(size_t));
+    biasWeightOffsets=(size_t*)malloc(weightLayerCount*sizeof(size_t));
+    weightRowStrides=(uint32_t*)malloc(weightLayerCount*sizeof(uint32_t));
+    parameterCount=computeParameterLayout(layerCount,layerNeuronCounts,weightOffsets,biasWeightOffsets,weightRowStrides);
+}
+
+RNNWeights::RNNWeights(uint32_t _layerCount, const uint32_t *_layerNeuronCounts, bool randomize)
+{
+    initializeLayout(_layerCount,_layerNeuronCounts);
+    uint32_t weightLayerCount=layerCount-1;
+    ownsParameters=true;
+    readOnly=false;
+    parameters=(rnnfloat_t*)alignedmemory::allocate(parameterCount*sizeof(rnnfloat_t));
+    clear(); // Bias weights and row padding start out as zeroes.
+
+    if(randomize)
+    {
+        srand(time(0));
+        for(uint32_t weightLayer=0;weightLayer<weightLayerCount;weightLayer++)
+        {
+            uint32_t neuronsInThisLayer=layerNeuronCounts[weightLayer];
+            uint32_t neuronsInNextLayer=layerNeuronCounts[weightLayer+1];
+            for(uint32_t neuronInThisLayer=0;neuronInThisLayer<neuronsInThisLayer;neuronInThisLayer++)
+            {
+                for(uint32_t neuronInNextLayer=0;neuronInNextLayer<neuronsInNextLayer;neuronInNextLayer++)
+                    getWeight(weightLayer,neuronInThisLayer,neuronInNextLayer)=-0.1+(((double)rand())/((double)RAND_MAX))*0.2;
+            }
+        }
+    }
+}
+
+RNNWeights::RNNWeights(uint32_t _layerCount, const uint32_t *_layerNeuronCounts, rnnfloat_t *_parameters, bool _readOnly)
+{
+    initializeLayout(_layerCount,_layerNeuronCounts);
+    ownsParameters=false;
+    readOnly=_readOnly;
+    parameters=_parameters;
+}
+
+RNNWeights::~RNNWeights()
+{
+    if(ownsParameters)
+        alignedmemory::release(parameters);
+    free(weightOffsets);
+    free(biasWeightOffsets);
+    free(weightRowStrides);
+    free(layerNeuronCounts);
+}
@@ -0,0 +1,52 @@
+#ifndef RNNWEIGHTS_H
+#define RNNWEIGHTS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctime>
+
+#include "alignedmemory.h"
+#include "rnnkernels.h" // rnnfloat_t
+
+// Here, the input and output layers are meant to be included in "_layerCount" and "_layerNeuronCounts".
+
+class RNNWeights
+{
+public:
+    // All weights and bias weights live in one contiguous, ALIGNEDMEMORY_ALIGNMENT-byte-aligned block.
+    // Weight layer "w" connects layer "w" to layer "w+1". Its matrix is stored row by row, one row per neuron in the next layer, so that all
+    // weights pointing to a neuron are contiguous; each row is padded with zeroes to a multiple of ALIGNEDMEMORY_ALIGNMENT bytes.
+    // Use getWeightRow()/getWeight()/getBiasWeights() instead of computing offsets by hand.
+    rnnfloat_t *parameters;
+    size_t parameterCount;
+    size_t *weightOffsets; // Dimensions: weight layers
+    size_t *biasWeightOffsets; // Dimensions: weight layers
+    uint32_t *weightRowStrides; // Dimensions: weight layers
+
+    uint32_t *layerNeuronCounts;
+    uint32_t layerCount;
+
+    bool ownsParameters; // False for a view of an external block (see RNNModelFile)
+    bool readOnly; // The parameters must not be changed (e.g. a read-only mapping); learning throws.
+
+
+    static size_t computeParameterLayout(uint32_t _layerCount,const uint32_t *_layerNeuronCounts,size_t *_weightOffsets,size_t *_biasWeightOffsets,uint32_t *_weightRowStrides); // Returns the parameter count.
+
+    inline rnnfloat_t *getWeightRow(uint32_t weightLayer,uint32_t neuronInNextLayer) {return parameters+weightOffsets[weightLayer]+(size_t)neuronInNextLayer*weightRowStrides[weightLayer];}
+    inline rnnfloat_t &getWeight(uint32_t weightLayer,uint32_t neuronInThisLayer,uint32_t neuronInNextLayer) {return getWeightRow(weightLayer,neuronInNextLayer)[neuronInThisLayer];}
+    inline rnnfloat_t *getBiasWeights(uint32_t weightLayer) {return parameters+biasWeightOffsets[weightLayer];}
+
+    void clear();
+
+    RNNWeights(uint32_t _layerCount,const uint32_t *_layerNeuronCounts,bool randomize); // If "randomize" is false, all values are zeroes.
+    // View of "parameterCount" values with the above layout at "_parameters", which must be ALIGNEDMEMORY_ALIGNMENT-byte-aligned and
+    // outlive the weights. Nothing is copied.
+    RNNWeights(uint32_t _layerCount,const uint32_t *_layerNeuronCounts,rnnfloat_t *_parameters,bool _readOnly);
+    ~RNNWeights();
+
+private:
+    void initializeLayout(uint32_t _layerCount,const uint32_t *_layerNeuronCounts);
+};
+
+#endif // RNNWEIGHTS_H